@@ -8,25 +8,26 @@ using namespace std;
 
 namespace Fourier {
 
+    template<typename P = default_parameter>
     class counter : public abstract_counter {
     protected:
+        constexpr static const uint32_t WINDOW = P::WINDOW;
+        constexpr static const uint32_t MAX_LENGTH = P::MAX_LENGTH;
         // meet alignment request
         static_assert((WINDOW * 4) % 16 == 0);
         static_assert(MAX_LENGTH % WINDOW == 0);
-        constexpr static const int DEPTH = (FULL_DEPTH * 4) / 6;
+        constexpr static const int DEPTH = (P::FULL_DEPTH * 4) / 6;
 
-        static PFFFT_Setup* setup;
+        inline static PFFFT_Setup* setup = pffft_new_setup(WINDOW, PFFFT_REAL);
         TIME start_time;
         TIME window_n;
         float* recent; // data in the most recent WINDOW
         float* output; // temp array for transform
         heap<record, DEPTH> history;
 
-        mutable STREAM_QUEUE cache{};
-
         void transform(const uint16_t start) {
             pffft_transform(setup, recent, output, nullptr, PFFFT_FORWARD);
-            for(int i = 0; i < WINDOW; i++)
+            for(uint32_t i = 0; i < WINDOW; i++)
                 history.insert({(uint16_t)(start + i), output[i]});
             memset(recent, 0, WINDOW * 4);
         }
@@ -34,6 +35,7 @@ namespace Fourier {
         counter() : start_time(0), window_n(0), history({}) {
             recent = static_cast<float *>(pffft_aligned_malloc(WINDOW * 4));
             output = static_cast<float *>(pffft_aligned_malloc(WINDOW * 4));
+            memset(recent, 0, WINDOW * 4);
         };
         ~counter() {
             pffft_aligned_free(recent);
@@ -72,15 +74,14 @@ namespace Fourier {
             return *this;
         }
 
-        void reset() override {
+        void reset() {
             start_time = 0;
             window_n = 0;
             memset(recent, 0, WINDOW * 4);
             history.reset();
-            cache.clear();
         }
 
-        bool count(TIME t, HASH, DATA c) override {
+        bool count(TIME t, HASH, DATA c) {
             assert(t >= start_time);
             if(start_time == 0) [[unlikely]] {
                 start_time = t;
@@ -95,61 +96,149 @@ namespace Fourier {
             return false;
         }
 
-        void flush() override {
+        void flush() {
             if(empty())
                 return;
             transform(window_n * WINDOW);
         }
 
-        bool empty() const override {
+        bool empty() const {
             return start_time == 0;
         }
 
-        TIME start() const override {
+        TIME start() const {
             return start_time;
         }
 
-        STREAM_QUEUE rebuild(HASH) const override {
-            assert(!empty());
-            if(!cache.empty())
-                return cache;
-
-            cache.resize(MAX_LENGTH);
-            static auto* origin = static_cast<float *>(pffft_aligned_malloc(MAX_LENGTH * 4));
-            static auto* buffer = static_cast<float *>(pffft_aligned_malloc(MAX_LENGTH * 4));
-            static auto* worker = static_cast<float *>(pffft_aligned_malloc(WINDOW * 4));
+        size_t serialize() const {
+            size_t result = 0;
+            result += sizeof(start_time);
+            result += history.serialize();
+            return result;
+        }
 
-            memset(origin, 0, MAX_LENGTH * 4);
+        /* finished counter as kept in history: the retained coefficients only, stored in a row arena as
+         *   header | coefficient values | positions
+         * the rebuild cache comes from the same arena on first use */
+        class sealed {
+            struct header {
+                TIME start_time;
+                uint16_t size;
+            };
+
+            const header* head;
+            arena* home;
+            mutable SAMPLE* cache = nullptr;
+
+            const float* values() const {
+                return reinterpret_cast<const float*>(head + 1);
+            }
+            const uint16_t* positions() const {
+                return reinterpret_cast<const uint16_t*>(values() + head->size);
+            }
+            sealed(const header* h, arena& a) : head(h), home(&a) {}
+        public:
+            sealed(const counter& c, arena& a) : home(&a) {
+                const uint16_t size = c.history.size;
+                auto h = a.allocate<header>(sizeof(header) + (sizeof(float) + sizeof(uint16_t)) * size);
+                *h = {c.start_time, size};
+                auto v = reinterpret_cast<float*>(h + 1);
+                auto p = reinterpret_cast<uint16_t*>(v + size);
+                for(int i = 0; i < size; i++) {
+                    v[i] = c.history.heap_data[i].data;
+                    p[i] = c.history.heap_data[i].pos;
+                }
+                head = h;
+            }
 
-            for(int i = 0; i < history.size; i++) {
-                uint16_t pos = history.heap_data[i].pos;
-                origin[pos] = history.heap_data[i].data;
+            span<const SAMPLE> rebuild(HASH) const {
+                return {cache_once(cache, *home, MAX_LENGTH, [this](SAMPLE* out) { build(out); }), MAX_LENGTH};
             }
-            for(int i = 0; i < MAX_LENGTH / WINDOW; i++) {
-                pffft_transform(setup, origin + i * WINDOW, buffer + i * WINDOW, worker, PFFFT_BACKWARD);
+        private:
+            void build(SAMPLE* out) const {
+                // transform buffers, one set per rebuilding thread
+                struct buffers {
+                    float* origin = static_cast<float *>(pffft_aligned_malloc(MAX_LENGTH * 4));
+                    float* buffer = static_cast<float *>(pffft_aligned_malloc(MAX_LENGTH * 4));
+                    float* worker = static_cast<float *>(pffft_aligned_malloc(WINDOW * 4));
+                    ~buffers() {
+                        pffft_aligned_free(origin);
+                        pffft_aligned_free(buffer);
+                        pffft_aligned_free(worker);
+                    }
+                };
+                thread_local buffers b;
+                float* origin = b.origin, *buffer = b.buffer, *worker = b.worker;
+
+                memset(origin, 0, MAX_LENGTH * 4);
+
+                for(int i = 0; i < head->size; i++)
+                    origin[positions()[i]] = values()[i];
+                for(uint32_t i = 0; i < MAX_LENGTH / WINDOW; i++) {
+                    pffft_transform(setup, origin + i * WINDOW, buffer + i * WINDOW, worker, PFFFT_BACKWARD);
+                }
+
+                // clamped into DATA: coefficients far off, as a decoded blob may hold, must not overflow it
+                for(uint32_t i = 0; i < MAX_LENGTH; i++) {
+                    const float d = buffer[i] / WINDOW;
+                    out[i].first = head->start_time + i;
+                    out[i].second = d >= 0 ? DATA(min<double>(d, numeric_limits<DATA>::max())) : 0;
+                }
             }
 
-            for(int i = 0; i < MAX_LENGTH; i++) {
-                cache[i].first = start_time + i;
-                cache[i].second = (buffer[i] / WINDOW) >= 0 ? (buffer[i] / WINDOW) : 0;
+        public:
+            TIME start() const {
+                return head->start_time;
             }
 
-            //pffft_aligned_free(origin);
-            //pffft_aligned_free(buffer);
+            // the record count, the positions as zigzag-coded differences from the one before, then the values raw
+            void encode(codec::writer& out) const {
+                out.varint(head->size);
+                int last = 0;
+                for(int i = 0; i < head->size; i++) {
+                    out.zigzag(positions()[i] - last);
+                    last = positions()[i];
+                }
+                for(int i = 0; i < head->size; i++)
+                    out.raw(values()[i]);
+            }
+            static sealed decode(codec::reader& in, arena& a, TIME start) {
+                const uint16_t size = in.bounded(DEPTH);
+                auto h = a.allocate<header>(sizeof(header) + (sizeof(float) + sizeof(uint16_t)) * size);
+                *h = {start, size};
+                auto v = reinterpret_cast<float*>(h + 1);
+                auto p = reinterpret_cast<uint16_t*>(v + size);
+                int64_t last = 0;
+                for(int i = 0; i < size; i++) {
+                    last += in.zigzag();
+                    if(last < 0 || last >= MAX_LENGTH)
+                        in.fail();
+                    p[i] = in.failed() ? 0 : last;
+                }
+                for(int i = 0; i < size; i++) {
+                    v[i] = in.raw<float>();
+                    if(!isfinite(v[i]))
+                        in.fail();
+                }
+                return sealed(h, a);
+            }
 
-            return cache;
-        }
+            // same count as counter::serialize before sealing
+            size_t serialize() const {
+                size_t result = 0;
+                result += sizeof(head->start_time);
+                // heap size
+                result += sizeof(uint16_t);
+                result += (sizeof(uint16_t) + sizeof(float)) * head->size;
+                return result;
+            }
+        };
 
-        size_t serialize() const override {
-            size_t result = 0;
-            result += sizeof(start_time);
-            result += history.serialize();
-            return result;
+        sealed seal(arena& a) const {
+            return sealed(*this, a);
         }
     };
 
-    PFFFT_Setup* counter::setup = pffft_new_setup(WINDOW, PFFFT_REAL);
-
 } // Fourier
 
 #endif //FOURIER_COUNTER_H
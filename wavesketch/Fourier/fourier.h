@@ -6,8 +6,10 @@
 
 using namespace std;
 
-class fourier : public basic_scheme<Fourier::table> {
-
+template<typename P = default_parameter>
+class fourier : public basic_scheme<Fourier::table<P>> {
+public:
+    constexpr static const uint64_t KIND = codec::kind<P>("fourier");
 };
 
 
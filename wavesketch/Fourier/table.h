@@ -8,7 +8,8 @@ using namespace std;
 
 namespace Fourier {
 
-class table : public basic_table<counter, ROUND(FULL_WIDTH * (FULL_DEPTH * 4 + 4), (((FULL_DEPTH * 4) / 6) * 6 + 4 * SAMPLE_RATE * 2 + 10))> {
+    template<typename P = default_parameter>
+    class table : public basic_table<table<P>, P, counter<P>, ROUND(P::FULL_WIDTH * (P::FULL_DEPTH * 4 + 4), (((P::FULL_DEPTH * 4) / 6) * 6 + 4 * P::SAMPLE_RATE * 2 + 10))> {
 
     };
 
@@ -7,47 +7,42 @@ using namespace std;
 
 namespace NaiveCMS {
 
+    template<typename P = default_parameter>
     class counter : public abstract_counter {
     protected:
-        constexpr static const int DEPTH = FULL_DEPTH;
+        constexpr static const int DEPTH = P::FULL_DEPTH;
         TIME start_time{};
         array<DATA, DEPTH> history{};
     public:
-        void reset() override {
+        void reset() {
             start_time = 0;
             history.fill(0);
         }
 
-        bool count(TIME t, HASH h, DATA c) override {
+        bool count(TIME t, HASH h, DATA c) {
             assert(t >= start_time);
             if(start_time == 0) [[unlikely]] {
                 start_time = t;
-            } else if(t - start_time >= MAX_LENGTH) [[unlikely]] {
+            } else if(t - start_time >= P::MAX_LENGTH) [[unlikely]] {
                 return true;
             }
             history[h % DEPTH] += c;
             return false;
         }
 
-        bool empty() const override {
+        bool empty() const {
             return start_time == 0;
         }
 
-        TIME start() const override {
+        TIME start() const {
             return start_time;
         }
 
-        STREAM_QUEUE rebuild(HASH h) const override { // TODO: fix this
-            cerr << "Should not reach here." << endl;
-            assert(false);
-            return {};
-        }
-
         DATA query(HASH h) const {
             return history[h % DEPTH];
         }
 
-        size_t serialize() const override {
+        size_t serialize() const {
             size_t result = 0;
             result += sizeof(start_time);
             // history has fixed length
@@ -55,6 +50,39 @@ namespace NaiveCMS {
                 result += sizeof(d);
             return result;
         }
+
+        /* finished counter as kept in history: a copy of its fields in a row arena */
+        class sealed {
+            const counter* c;
+        public:
+            sealed(const counter& from, arena& a) {
+                auto to = a.allocate<counter>(sizeof(counter));
+                c = new(to) counter(from);
+            }
+
+            // keys hash with their time, so tables query slots instead
+            span<const SAMPLE> rebuild(HASH) const { // TODO: fix this
+                cerr << "Should not reach here." << endl;
+                assert(false);
+                return {};
+            }
+
+            DATA query(HASH h) const {
+                return c->query(h);
+            }
+
+            TIME start() const {
+                return c->start();
+            }
+
+            size_t serialize() const {
+                return c->serialize();
+            }
+        };
+
+        sealed seal(arena& a) const {
+            return sealed(*this, a);
+        }
     };
 
 } // NaiveCMS
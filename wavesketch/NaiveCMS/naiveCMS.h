@@ -6,7 +6,8 @@
 
 using namespace std;
 
-class naiveCMS : public basic_scheme<NaiveCMS::table> {
+template<typename P = default_parameter>
+class naiveCMS : public basic_scheme<NaiveCMS::table<P>> {
 
 };
 
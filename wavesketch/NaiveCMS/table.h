@@ -9,60 +9,61 @@ using namespace std;
 
 namespace NaiveCMS {
 
-    class table : public basic_table<counter> {
+    template<typename P = default_parameter>
+    class table : public basic_table<table<P>, P, counter<P>> {
+        friend typename table::table_base;
     protected:
         TIME start_time{};
         TIME last_time{};
 
-        void derived_reset() override {
+        void derived_reset() {
             start_time = 0;
             last_time = 0;
         }
     public:
-        bool count(const five_tuple& f, TIME t, DATA c) override {
+        // keys hash with their time, so the five-tuple digest is unused
+        bool count(const five_tuple& f, flow_digest, TIME t, DATA c) {
             if(start_time == 0) [[unlikely]] {
                 start_time = t;
             }
 
             last_time = t;
             key k{f, t};
-            for(int row = 0; row < HEIGHT; row++) {
-                HASH h = k.hash(seeds[row]);
-                HASH rem = h % WIDTH;
-                HASH quo = h / WIDTH;
-                bool result = counters[row][rem].count(t, quo, c);
+            for(int row = 0; row < table::HEIGHT; row++) {
+                HASH h = k.hash(table::seeds[row]);
+                HASH rem = h % table::WIDTH;
+                HASH quo = h / table::WIDTH;
+                bool result = table::counters[row][rem].count(t, quo, c);
                 if(result) {
-                    history[row][rem].push_back(counters[row][rem]);
-                    counters[row][rem].reset();
-                    counters[row][rem].count(t, quo, c);
+                    table::save_counter(row, rem);
+                    table::counters[row][rem].count(t, quo, c);
                 }
             }
 
             return true;
         }
 
+        // rows depend on the time as well, so there is nothing to prefetch from the digest
+        void prefetch(flow_digest) const { }
+
         STREAM_QUEUE rebuild(const five_tuple& f, TIME start, TIME last) const {
-            vector<array<DATA, HEIGHT>> merger(last - start + 1);
-            STREAM_QUEUE result(last - start + 1);
+            vector<array<DATA, table::HEIGHT>> merger(last - start + 1);
+            STREAM_QUEUE result(start, last - start + 1);
 
             for(TIME t = start; t <= last; t++) {
                 key k{f, t};
                 auto& slot = merger[t - start];
-                for(int row = 0; row < HEIGHT; row++) {
-                    HASH h = k.hash(seeds[row]);
-                    HASH rem = h % WIDTH;
-                    HASH quo = h / WIDTH;
-                    auto& hc = history[row][rem];
-                    auto c = first_history(hc, t);
-                    if(c != hc.end() && t >= c->start())
-                        slot[row] = c->query(quo);
-                    else
-                        slot[row] = 0;
+                for(int row = 0; row < table::HEIGHT; row++) {
+                    HASH h = k.hash(table::seeds[row]);
+                    HASH rem = h % table::WIDTH;
+                    HASH quo = h / table::WIDTH;
+                    auto c = table::overlapping(row, rem, t, t);
+                    slot[row] = c.empty() ? 0 : c.front().query(quo);
                 }
 
-                DATA min = select_val(slot);
+                DATA min = this->select_val(slot);
                 assert(min >= 0);
-                result[t - start] = make_pair(t, min);
+                result.value(t - start) = min;
             }
 
             return result;
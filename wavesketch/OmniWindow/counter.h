@@ -7,22 +7,21 @@ using namespace std;
 
 namespace OmniWindow {
 
+    template<typename P = default_parameter>
     class counter : public abstract_counter {
     protected:
-        constexpr static const int DEPTH = FULL_DEPTH;
+        constexpr static const uint32_t MAX_LENGTH = P::MAX_LENGTH;
+        constexpr static const int DEPTH = P::FULL_DEPTH;
         constexpr static const int RATE = MAX_LENGTH / DEPTH;
         TIME start_time{};
         array<DATA, DEPTH + (DEPTH * RATE < MAX_LENGTH ? 1 : 0)> history{};
-
-        mutable STREAM_QUEUE cache{};
     public:
-        void reset() override {
+        void reset() {
             start_time = 0;
             history.fill(0);
-            cache.clear();
         }
 
-        bool count(TIME t, HASH, DATA c) override {
+        bool count(TIME t, HASH, DATA c) {
             assert(t >= start_time);
             if(start_time == 0) [[unlikely]] {
                 start_time = t;
@@ -34,36 +33,15 @@ namespace OmniWindow {
             return false;
         }
 
-        bool empty() const override {
+        bool empty() const {
             return start_time == 0;
         }
 
-        TIME start() const override {
+        TIME start() const {
             return start_time;
         }
 
-        STREAM_QUEUE rebuild(HASH) const override {
-            assert(!empty());
-            if(!cache.empty())
-                return cache;
-
-            cache.resize(MAX_LENGTH);
-            int pos = 0;
-            for(; pos < DEPTH * RATE; pos++) {
-                cache[pos].first = start_time + pos;
-                cache[pos].second = history[pos / RATE] / RATE;
-                assert(cache[pos].second >= 0);
-            }
-            for(; pos < MAX_LENGTH; pos++) {
-                cache[pos].first = start_time + pos;
-                assert(MAX_LENGTH - DEPTH * RATE > 0);
-                cache[pos].second = history[pos / RATE] / (MAX_LENGTH - DEPTH * RATE);
-                assert(cache[pos].second >= 0);
-            }
-            return cache;
-        }
-
-        size_t serialize() const override {
+        size_t serialize() const {
             size_t result = 0;
             result += sizeof(start_time);
             // history has fixed length
@@ -71,6 +49,55 @@ namespace OmniWindow {
                 result += sizeof(d);
             return result;
         }
+
+        /* finished counter as kept in history: a copy of its fields in a row arena, rebuilt lazily slot by slot */
+        class sealed {
+            const counter* c;
+        public:
+            sealed(const counter& from, arena& a) {
+                auto to = a.allocate<counter>(sizeof(counter));
+                c = new(to) counter(from);
+            }
+
+            auto rebuild(HASH) const {
+                return views::iota(0u, MAX_LENGTH) | views::transform([c = c](uint32_t pos) {
+                    DATA d;
+                    if(pos < DEPTH * RATE)
+                        d = c->history[pos / RATE] / RATE;
+                    else {
+                        assert(MAX_LENGTH - DEPTH * RATE > 0);
+                        d = c->history[pos / RATE] / (MAX_LENGTH - DEPTH * RATE);
+                    }
+                    assert(d >= 0);
+                    return SAMPLE(c->start_time + pos, d);
+                });
+            }
+
+            TIME start() const {
+                return c->start();
+            }
+
+            size_t serialize() const {
+                return c->serialize();
+            }
+
+            // the slots, which only ever add counts
+            void encode(codec::writer& out) const {
+                for(auto d : c->history)
+                    out.varint(d);
+            }
+            static sealed decode(codec::reader& in, arena& a, TIME start) {
+                counter from;
+                from.start_time = start;
+                for(auto& d : from.history)
+                    d = in.bounded(numeric_limits<DATA>::max());
+                return sealed(from, a);
+            }
+        };
+
+        sealed seal(arena& a) const {
+            return sealed(*this, a);
+        }
     };
 
 } // OmniWindow
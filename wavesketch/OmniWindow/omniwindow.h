@@ -6,8 +6,10 @@
 
 using namespace std;
 
-class omniwindow : public basic_scheme<OmniWindow::table> {
-
+template<typename P = default_parameter>
+class omniwindow : public basic_scheme<OmniWindow::table<P>> {
+public:
+    constexpr static const uint64_t KIND = codec::kind<P>("omniwindow");
 };
 
 
@@ -8,7 +8,8 @@ using namespace std;
 
 namespace OmniWindow {
 
-    class table : public basic_table<counter> {
+    template<typename P = default_parameter>
+    class table : public basic_table<table<P>, P, counter<P>> {
 
     };
 
@@ -7,9 +7,9 @@ using namespace std;
 
 namespace PersistAMS {
 
-    class record : public STREAM_QUEUE::value_type {
+    class record : public SAMPLE {
     public:
-        using Base = STREAM_QUEUE::value_type;
+        using Base = SAMPLE;
         using Base::Base;
 
         size_t serialize() const {
@@ -20,12 +20,17 @@ namespace PersistAMS {
         }
     };
 
+    template<typename P = default_parameter>
     class counter : public abstract_counter {
+    public:
+        // sampling draws from gen
+        constexpr static const bool STATIC_RANDOM = true;
     protected:
+        constexpr static const uint32_t MAX_LENGTH = P::MAX_LENGTH;
         // random generator
-        constexpr static const int DELTA = MAX_LENGTH / ROUND(FULL_DEPTH * 4 + 4 - 24, 10);
-        static mt19937 gen;
-        static uniform_int_distribution<> dis;
+        constexpr static const int DELTA = MAX_LENGTH / ROUND(P::FULL_DEPTH * 4 + 4 - 24, 10);
+        inline static mt19937 gen{0xAEABDC85};
+        inline static uniform_int_distribution<> dis{1, DELTA};
         static bool test() {
             return dis(gen) == 1;
         }
@@ -33,11 +38,14 @@ namespace PersistAMS {
         TIME start_time{};
         TIME last_time[2]{};
         DATA value[2]{};
-        list<record> history[2]{};
-
-        mutable STREAM_QUEUE cache{};
+        list<record, pool_allocator<record>> history[2]{};
     public:
-        void reset() override {
+        // allocate history nodes from p
+        void bind(pool& p) {
+            for(auto& half : history)
+                half = decay_t<decltype(half)>(pool_allocator<record>(&p));
+        }
+        void reset() {
             start_time = 0;
             last_time[0] = 0;
             last_time[1] = 0;
@@ -45,10 +53,9 @@ namespace PersistAMS {
             value[1] = 0;
             history[0].clear();
             history[1].clear();
-            cache.clear();
         }
 
-        bool count(TIME t, HASH h, DATA c) override {
+        bool count(TIME t, HASH h, DATA c) {
             HASH sign = h % 2;
             assert(t >= last_time[sign]);
             if(start_time == 0) [[unlikely]] {
@@ -67,7 +74,7 @@ namespace PersistAMS {
             return false;
         }
 
-        void flush() override {
+        void flush() {
             if(empty())
                 return;
             if(test())
@@ -76,62 +83,146 @@ namespace PersistAMS {
                 history[1].emplace_back(last_time[1], value[1]);
         }
 
-        bool empty() const override {
+        bool empty() const {
             return start_time == 0;
         }
 
-        TIME start() const override {
+        TIME start() const {
             return start_time;
         }
 
-        STREAM_QUEUE rebuild(HASH h) const override {
-            assert(!empty());
-            DATA sign = h % 2 ? 1 : -1;
-            if(cache.empty()) {
-                cache.resize(MAX_LENGTH);
+        size_t serialize() const {
+            size_t result = 0;
+            result += sizeof(start_time);
+            // counter for histories
+            result += sizeof(uint16_t) * 2;
+            for(auto& r : history[0])
+                result += r.serialize();
+            for(auto& r : history[1])
+                result += r.serialize();
+            return result;
+        }
+
+        /* finished counter as kept in history: its sampled records only, stored in a row arena as
+         *   header | records of the positive half | records of the negative half
+         * the rebuild cache comes from the same arena on first use */
+        class sealed {
+            struct header {
+                TIME start_time;
+                uint16_t size[2];
+            };
+
+            const header* head;
+            arena* home;
+            // unsigned values
+            mutable SAMPLE* cache = nullptr;
+
+            const record* records(int half) const {
+                return reinterpret_cast<const record*>(head + 1) + (half ? head->size[0] : 0);
+            }
+            void build(SAMPLE* out) const {
                 DATA last_v0 = 0;
                 DATA last_v1 = 0;
-                auto p0 = history[0].begin();
-                auto p1 = history[1].begin();
-                for(int pos = 0; pos < MAX_LENGTH; pos++) {
-                    TIME t = start_time + pos;
+                auto p0 = records(0), end0 = p0 + head->size[0];
+                auto p1 = records(1), end1 = p1 + head->size[1];
+                for(uint32_t pos = 0; pos < MAX_LENGTH; pos++) {
+                    TIME t = head->start_time + pos;
                     DATA v = 0;
-                    if(p0 != history[0].end() && t >= p0->first) {
+                    if(p0 != end0 && t >= p0->first) {
                         v += p0->second - last_v0;
                         last_v0 = p0->second;
                         p0++;
                     }
-                    if(p1 != history[1].end() && t >= p1->first) {
+                    if(p1 != end1 && t >= p1->first) {
                         v -= p1->second - last_v1;
                         last_v1 = p1->second;
                         p1++;
                     }
-                    cache[pos].first = t;
-                    cache[pos].second = v;
+                    out[pos].first = t;
+                    out[pos].second = v;
                 }
             }
+            sealed(const header* h, arena& a) : head(h), home(&a) {}
+        public:
+            sealed(const counter& c, arena& a) : home(&a) {
+                const uint16_t size[2] = {(uint16_t)c.history[0].size(), (uint16_t)c.history[1].size()};
+                auto h = a.allocate<header>(sizeof(header) + sizeof(record) * (size[0] + size[1]));
+                *h = {c.start_time, {size[0], size[1]}};
+                auto r = reinterpret_cast<record*>(h + 1);
+                for(auto& half : c.history)
+                    r = uninitialized_copy(half.begin(), half.end(), r);
+                head = h;
+            }
 
-            STREAM_QUEUE result = cache;
-            for(auto& p : result)
-                p.second = sign * p.second >= 0 ? sign * p.second : 0;
-            return result;
-        }
+            auto rebuild(HASH h) const {
+                DATA sign = h % 2 ? 1 : -1;
+                auto values = cache_once(cache, *home, MAX_LENGTH, [this](SAMPLE* out) { build(out); });
+                return span<const SAMPLE>(values, MAX_LENGTH) | views::transform([sign](SAMPLE p) {
+                    p.second = sign * p.second >= 0 ? sign * p.second : 0;
+                    return p;
+                });
+            }
 
-        size_t serialize() const override {
-            size_t result = 0;
-            result += sizeof(start_time);
-            // counter for histories
-            result += sizeof(uint16_t) * 2;
-            for(auto& r : history[0])
-                result += r.serialize();
-            for(auto& r : history[1])
-                result += r.serialize();
-            return result;
+            TIME start() const {
+                return head->start_time;
+            }
+
+            // the record counts of both halves, then per half the times and values of its records, each a
+            // zigzag-coded difference from the one before, from the start and zero
+            void encode(codec::writer& out) const {
+                out.varint(head->size[0]);
+                out.varint(head->size[1]);
+                for(int half = 0; half < 2; half++) {
+                    int64_t t = head->start_time, v = 0;
+                    for(auto r = records(half); r != records(half) + head->size[half]; r++) {
+                        out.zigzag(int64_t(r->first) - t);
+                        out.zigzag(int64_t(r->second) - v);
+                        t = r->first;
+                        v = r->second;
+                    }
+                }
+            }
+            static sealed decode(codec::reader& in, arena& a, TIME start) {
+                constexpr static const uint16_t most = numeric_limits<uint16_t>::max();
+                const uint16_t size[2] = {(uint16_t)in.bounded(most), (uint16_t)in.bounded(most)};
+                auto h = a.allocate<header>(sizeof(header) + sizeof(record) * (size[0] + size[1]));
+                *h = {start, {size[0], size[1]}};
+                auto r = reinterpret_cast<record*>(h + 1);
+                // per half, times rise strictly within MAX_LENGTH of the start and the running sums never fall
+                for(int half = 0; half < 2; half++) {
+                    int64_t t = start, v = 0;
+                    for(int i = 0; i < size[half]; i++, r++) {
+                        const int64_t dt = in.zigzag(), dv = in.zigzag();
+                        if(dt < (i > 0) || dt >= MAX_LENGTH || t + dt >= int64_t(start) + MAX_LENGTH || dv < 0 ||
+                           dv > numeric_limits<DATA>::max() - v)
+                            in.fail();
+                        if(!in.failed()) {
+                            t += dt;
+                            v += dv;
+                        }
+                        new(r) record(t, v);
+                    }
+                }
+                return sealed(h, a);
+            }
+
+            // same count as counter::serialize before sealing
+            size_t serialize() const {
+                size_t result = 0;
+                result += sizeof(head->start_time);
+                // counter for histories
+                result += sizeof(uint16_t) * 2;
+                for(int i = 0; i < head->size[0] + head->size[1]; i++)
+                    result += records(0)[i].serialize();
+                return result;
+            }
+        };
+
+        sealed seal(arena& a) const {
+            return sealed(*this, a);
         }
-    };
 
-    mt19937 counter::gen(0xAEABDC85);
-    uniform_int_distribution<> counter::dis(1, DELTA);
+    };
 
 } // PersistAMS
 
@@ -6,8 +6,10 @@
 
 using namespace std;
 
-class persistAMS : public basic_scheme<PersistAMS::table> {
-
+template<typename P = default_parameter>
+class persistAMS : public basic_scheme<PersistAMS::table<P>> {
+public:
+    constexpr static const uint64_t KIND = codec::kind<P>("persistAMS");
 };
 
 
@@ -8,10 +8,12 @@ using namespace std;
 
 namespace PersistAMS {
 
-    class table : public basic_table<counter> {
+    template<typename P = default_parameter>
+    class table : public basic_table<table<P>, P, counter<P>> {
+        friend typename table::table_base;
     protected:
-        DATA select_val(array<DATA, HEIGHT>& vals) const override {
-            return select_median(vals);
+        DATA select_val(array<DATA, table::HEIGHT>& vals) const {
+            return table::select_median(vals);
         }
     };
 
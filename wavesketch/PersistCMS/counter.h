@@ -8,42 +8,52 @@ using namespace std;
 
 namespace PersistCMS {
 
+    template<typename P = default_parameter>
     class counter : public abstract_counter {
     protected:
-#ifdef BY_BYTES
-        constexpr static const int DELTA = PCMS_DELTA * 1024;
-#else
-        constexpr static const int DELTA = PCMS_DELTA;
-#endif
+        // error bound of a line, resolved by configure rather than per packet
+        inline static int error = P::PCMS_DELTA;
+
+        static int delta() {
+            return error;
+        }
 
         TIME start_time{};
         TIME last_time{};
         DATA value{};
 
-        list<line> history{};
+        list<line, pool_allocator<line>> history{};
         polygon solver{};
-
-        mutable STREAM_QUEUE cache{};
     public:
-        void reset() override {
+        // resolve the error bound from the run's options; tables call it when built and reset
+        static void configure(const options& o) {
+            const int e = o.by_bytes ? P::PCMS_DELTA * 1024 : P::PCMS_DELTA;
+            if(error != e)
+                error = e;
+        }
+        // allocate history and solver nodes from p
+        void bind(pool& p) {
+            history = decltype(history)(pool_allocator<line>(&p));
+            solver.bind(p);
+        }
+        void reset() {
             start_time = 0;
             last_time = 0;
             value = 0;
             history.clear();
             solver.reset();
-            cache.clear();
         }
 
-        bool count(TIME t, HASH, DATA c) override {
+        bool count(TIME t, HASH, DATA c) {
             assert(t >= last_time);
             if(start_time == 0) [[unlikely]] {
                 start_time = last_time = t;
-            } else if(t - start_time >= MAX_LENGTH) [[unlikely]] {
+            } else if(t - start_time >= P::MAX_LENGTH) [[unlikely]] {
                 flush();
                 return true;
             }
             if(t > last_time) {
-                line result = solver.insert(last_time, value, DELTA);
+                line result = solver.insert(last_time, value, delta());
                 if(result.first != 0)
                     history.push_back(result);
             }
@@ -52,11 +62,11 @@ namespace PersistCMS {
             return false;
         }
 
-        void flush() override {
+        void flush() {
             if(empty())
                 return;
             // the last value will not change by now, feed to solver
-            line result = solver.insert(last_time, value, DELTA);
+            line result = solver.insert(last_time, value, delta());
             // solver outputs a line => the last value cannot fit in that line => insert 2 lines
             // no output from solver => the last value fits in the recent line => insert 1 line
             if(result.first != 0)
@@ -69,38 +79,15 @@ namespace PersistCMS {
             return result >= 0 ? result : 0;
         }
 
-        bool empty() const override {
+        bool empty() const {
             return start_time == 0;
         }
 
-        TIME start() const override {
+        TIME start() const {
             return start_time;
         }
 
-        STREAM_QUEUE rebuild(HASH) const override {
-            assert(!empty());
-            if(!cache.empty())
-                return cache;
-
-            // reconstruct from history
-            TIME t = start_time;
-            TIME last_t = history.back().first;
-            DATA last_d = 0;
-            cache.resize(last_t - t + 1);
-
-            for(auto& p : history) {
-                for(; t <= p.first; t++) {
-                    DATA d = evaluate(p.second, t);
-                    cache[t - start_time].first = t;
-                    cache[t - start_time].second = d - last_d >= 0 ? d - last_d : 0;
-                    last_d = d;
-                }
-            }
-
-            return cache;
-        }
-
-        size_t serialize() const override {
+        size_t serialize() const {
             size_t result = 0;
             result += sizeof(start_time);
             // counter for history
@@ -109,6 +96,127 @@ namespace PersistCMS {
                 result += l.serialize();
             return result;
         }
+
+        /* finished counter as kept in history: its line segments only, stored in a row arena as
+         *   header | segment lines | segment end times
+         * the rebuild cache comes from the same arena on first use */
+        class sealed {
+            // aligned for the nodes that follow it, since the arena aligns a block only for its own type
+            struct alignas(node) header {
+                TIME start_time;
+                uint32_t size;
+            };
+
+            const header* head;
+            arena* home;
+            mutable SAMPLE* cache = nullptr;
+
+            const node* nodes() const {
+                return reinterpret_cast<const node*>(head + 1);
+            }
+            const TIME* ends() const {
+                return reinterpret_cast<const TIME*>(nodes() + head->size);
+            }
+            size_t length() const {
+                return ends()[head->size - 1] - head->start_time + 1;
+            }
+            sealed(const header* h, arena& a) : head(h), home(&a) {}
+        public:
+            sealed(const counter& c, arena& a) : home(&a) {
+                static_assert(alignof(header) >= alignof(node));
+                const uint32_t size = c.history.size();
+                auto h = a.allocate<header>(sizeof(header) + (sizeof(node) + sizeof(TIME)) * size);
+                *h = {c.start_time, size};
+                auto n = reinterpret_cast<node*>(h + 1);
+                auto e = reinterpret_cast<TIME*>(n + size);
+                for(auto& l : c.history) {
+                    *n++ = l.second;
+                    *e++ = l.first;
+                }
+                head = h;
+            }
+
+            span<const SAMPLE> rebuild(HASH) const {
+                return {cache_once(cache, *home, length(), [this](SAMPLE* out) { build(out); }), length()};
+            }
+        private:
+            // reconstruct from history
+            void build(SAMPLE* out) const {
+                TIME t = head->start_time;
+                DATA last_d = 0;
+                for(uint32_t i = 0; i < head->size; i++) {
+                    for(; t <= ends()[i]; t++) {
+                        DATA d = evaluate(nodes()[i], t);
+                        out[t - head->start_time].first = t;
+                        out[t - head->start_time].second = d - last_d >= 0 ? d - last_d : 0;
+                        last_d = d;
+                    }
+                }
+            }
+
+        public:
+            TIME start() const {
+                return head->start_time;
+            }
+
+            // the segment count, the ends as differences from the start and then from the end before, then the
+            // nodes raw
+            void encode(codec::writer& out) const {
+                out.varint(head->size);
+                TIME last = head->start_time;
+                for(uint32_t i = 0; i < head->size; i++) {
+                    out.varint(ends()[i] - last);
+                    last = ends()[i];
+                }
+                for(uint32_t i = 0; i < head->size; i++) {
+                    out.raw(nodes()[i].first);
+                    out.raw(nodes()[i].second);
+                }
+            }
+            static sealed decode(codec::reader& in, arena& a, TIME start) {
+                // ends rise strictly within MAX_LENGTH ticks, and every segment takes its two raw doubles and a
+                // byte of end at least: bounded before anything is allocated for it
+                const uint32_t size = in.bounded(min<size_t>(P::MAX_LENGTH, in.remaining() / (1 + 2 * sizeof(double))));
+                if(size == 0)
+                    in.fail();
+                auto h = a.allocate<header>(sizeof(header) + (sizeof(node) + sizeof(TIME)) * size);
+                *h = {start, size};
+                auto n = reinterpret_cast<node*>(h + 1);
+                auto e = reinterpret_cast<TIME*>(n + size);
+                // ends rise strictly from the first, at or past the start, and stay within MAX_LENGTH of it
+                uint64_t span = 0;
+                for(uint32_t i = 0; i < size && !in.failed(); i++) {
+                    const uint64_t delta = in.bounded(P::MAX_LENGTH);
+                    span += delta;
+                    if((i > 0 && delta == 0) || span >= P::MAX_LENGTH)
+                        in.fail();
+                    e[i] = start + span;
+                }
+                // evaluate rounds the nodes to integers, so they must be finite
+                for(uint32_t i = 0; i < size; i++) {
+                    n[i].first = in.raw<double>();
+                    n[i].second = in.raw<double>();
+                    if(!isfinite(n[i].first) || !isfinite(n[i].second))
+                        in.fail();
+                }
+                return sealed(h, a);
+            }
+
+            // same count as counter::serialize before sealing
+            size_t serialize() const {
+                size_t result = 0;
+                result += sizeof(head->start_time);
+                // counter for history
+                result += sizeof(uint16_t);
+                for(uint32_t i = 0; i < head->size; i++)
+                    result += sizeof(TIME) + nodes()[i].serialize();
+                return result;
+            }
+        };
+
+        sealed seal(arena& a) const {
+            return sealed(*this, a);
+        }
     };
 
 } // PersistCMS
@@ -6,8 +6,10 @@
 
 using namespace std;
 
-class persistCMS : public basic_scheme<PersistCMS::table> {
-
+template<typename P = default_parameter>
+class persistCMS : public basic_scheme<PersistCMS::table<P>> {
+public:
+    constexpr static const uint64_t KIND = codec::kind<P>("persistCMS");
 };
 
 
@@ -39,9 +39,9 @@ namespace PersistCMS {
     class polygon {
     protected:
         // store upper vertices from leftmost to rightmost
-        list<node> upper{};
+        list<node, pool_allocator<node>> upper{};
         // store lower vertices from leftmost to rightmost
-        list<node> lower{};
+        list<node, pool_allocator<node>> lower{};
 
         // force to generate segment for the first data
         TIME last_time = 0;
@@ -129,6 +129,12 @@ namespace PersistCMS {
     public:
         polygon() = default;
 
+        // allocate vertices from p
+        void bind(pool& p) {
+            upper = decltype(upper)(pool_allocator<node>(&p));
+            lower = decltype(lower)(pool_allocator<node>(&p));
+        }
+
         void reset() {
             upper.clear();
             lower.clear();
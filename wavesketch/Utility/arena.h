@@ -0,0 +1,221 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "types.h"
+
+using namespace std;
+
+/* bump allocator: the backing store of one table row, or of a pool
+ *   blocks never move, so pointers stay valid until reset; nothing is freed one by one but power-of-two slots,
+ *   which acquire hands out again once released
+ *   blocks double in size, and reset keeps the largest, so a refilled arena allocates once */
+class arena {
+    constexpr static const size_t MIN_BLOCK = 1u << 16;
+
+    vector<unique_ptr<BYTE[]>> blocks{};
+    size_t block_size = 0;
+    BYTE* cursor = nullptr;
+    BYTE* limit = nullptr;
+    size_t used = 0;
+    size_t held = 0;
+    // serializes allocate_shared
+    mutex guard{};
+    // released slots of 2^k bytes, linked through their first bytes
+    void* slots[64]{};
+
+    void grow(size_t bytes) {
+        block_size = max(max(MIN_BLOCK, block_size * 2), bytes);
+        blocks.push_back(make_unique_for_overwrite<BYTE[]>(block_size));
+        held += block_size;
+        cursor = blocks.back().get();
+        limit = cursor + block_size;
+    }
+public:
+    arena() = default;
+    arena(const arena&) = delete;
+    arena& operator=(const arena&) = delete;
+
+    // uninitialized room for bytes, aligned for T
+    template<typename T>
+    T* allocate(size_t bytes) {
+        auto align = [](BYTE* p) {
+            return p + (-reinterpret_cast<uintptr_t>(p) & (alignof(T) - 1));
+        };
+        BYTE* p = align(cursor);
+        if(cursor == nullptr || p + bytes > limit) [[unlikely]] {
+            grow(bytes);
+            p = cursor;
+        }
+        cursor = p + bytes;
+        used += bytes;
+        return reinterpret_cast<T*>(p);
+    }
+
+    // allocate for callers that may run concurrently, such as const rebuilds filling their caches;
+    // plain allocate must not overlap with it
+    template<typename T>
+    T* allocate_shared(size_t bytes) {
+        lock_guard lock(guard);
+        return allocate<T>(bytes);
+    }
+
+    // room for bytes rounded up to a power of two, aligned for any type; bytes becomes the room of the slot
+    void* acquire(size_t& bytes) {
+        const unsigned k = bit_width(max(bytes, sizeof(void*)) - 1);
+        bytes = size_t(1) << k;
+        if(void* p = slots[k]) {
+            slots[k] = *static_cast<void**>(p);
+            return p;
+        }
+        return allocate<max_align_t>(bytes);
+    }
+    // hand a slot of acquire, of the bytes it returned, to the next acquire of that size
+    void release(void* p, size_t bytes) {
+        const unsigned k = countr_zero(bytes);
+        *static_cast<void**>(p) = slots[k];
+        slots[k] = p;
+    }
+
+    void reset() {
+        fill(begin(slots), end(slots), nullptr);
+        if(blocks.size() > 1) {
+            swap(blocks.front(), blocks.back());
+            blocks.resize(1);
+        }
+        cursor = blocks.empty() ? nullptr : blocks.front().get();
+        limit = cursor + (blocks.empty() ? 0 : block_size);
+        held = blocks.empty() ? 0 : block_size;
+        used = 0;
+    }
+
+    // bytes handed out since the last reset
+    size_t size() const { return used; }
+    // bytes held, including unused room
+    size_t capacity() const { return held; }
+};
+
+// growable array in an arena: growing copies into a slot twice as large and releases the old one to the arena,
+// so arrays of a row reuse each other's outgrown slots; dropped in O(1) by clear, which must come with (or before)
+// a reset of the arena
+template<typename T>
+class arena_array {
+    static_assert(is_trivially_copyable_v<T> && is_trivially_destructible_v<T>);
+    static_assert(alignof(T) <= alignof(max_align_t));
+
+    T* data = nullptr;
+    uint32_t count = 0;
+    uint32_t room = 0;
+public:
+    void push_back(arena& a, const T& v) {
+        if(count == room) [[unlikely]] {
+            // a slot of at least 4 elements holds more than half its bytes in whole elements
+            const size_t slot = bit_ceil(sizeof(T) * room);
+            size_t bytes = max(sizeof(T) * 4, slot * 2);
+            T* grown = static_cast<T*>(a.acquire(bytes));
+            if(count > 0) {
+                memcpy(grown, data, sizeof(T) * count);
+                a.release(data, slot);
+            }
+            data = grown;
+            room = bytes / sizeof(T);
+        }
+        data[count++] = v;
+    }
+    void clear() {
+        data = nullptr;
+        count = room = 0;
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T* begin() { return data; }
+    T* end() { return data + count; }
+    const T* begin() const { return data; }
+    const T* end() const { return data + count; }
+    T& operator[](size_t i) { return data[i]; }
+    const T& operator[](size_t i) const { return data[i]; }
+    T& back() { return data[count - 1]; }
+    const T& back() const { return data[count - 1]; }
+};
+
+/* fixed-size free lists over an arena, for node-based containers that allocate and free all the time
+ *   requests up to MAX_NODE bytes are rounded to a multiple of GRAIN and recycled, larger ones just bump;
+ *   reset forgets every free list and rewinds the arena in O(1) */
+class pool {
+    constexpr static const size_t GRAIN = 16;
+    constexpr static const size_t MAX_NODE = 256;
+
+    arena memory{};
+    void* free[MAX_NODE / GRAIN]{};
+public:
+    void* allocate(size_t bytes) {
+        if(bytes > MAX_NODE) [[unlikely]]
+            return memory.allocate<max_align_t>(bytes);
+        size_t c = (bytes - 1) / GRAIN;
+        if(free[c] != nullptr) {
+            void* p = free[c];
+            free[c] = *static_cast<void**>(p);
+            return p;
+        }
+        return memory.allocate<max_align_t>((c + 1) * GRAIN);
+    }
+    void deallocate(void* p, size_t bytes) {
+        if(bytes > MAX_NODE) [[unlikely]]
+            return;
+        size_t c = (bytes - 1) / GRAIN;
+        *static_cast<void**>(p) = free[c];
+        free[c] = p;
+    }
+
+    // every container allocating from the pool must be empty or abandoned by now
+    void reset() {
+        fill(begin(free), end(free), nullptr);
+        memory.reset();
+    }
+};
+
+// allocator over a pool, or over the global heap while unbound; it follows its container on copy, move and
+// swap, so assigning an empty container built with a bound allocator moves a container into the pool
+template<typename T>
+struct pool_allocator {
+    typedef T value_type;
+    typedef true_type propagate_on_container_copy_assignment;
+    typedef true_type propagate_on_container_move_assignment;
+    typedef true_type propagate_on_container_swap;
+
+    pool* source = nullptr;
+
+    pool_allocator() = default;
+    explicit pool_allocator(pool* p) : source(p) {}
+    template<typename U>
+    pool_allocator(const pool_allocator<U>& other) : source(other.source) {}
+
+    T* allocate(size_t n) {
+        static_assert(alignof(T) <= alignof(max_align_t));
+        if(source == nullptr)
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        return static_cast<T*>(source->allocate(n * sizeof(T)));
+    }
+    void deallocate(T* p, size_t n) {
+        if(source == nullptr)
+            ::operator delete(p);
+        else
+            source->deallocate(p, n * sizeof(T));
+    }
+
+    template<typename U>
+    bool operator==(const pool_allocator<U>& other) const { return source == other.source; }
+};
+
+#endif //ARENA_H
@@ -0,0 +1,179 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "parameter.h"
+#include "types.h"
+
+using namespace std;
+
+/* compact binary form of sealed sketch state, written and read sequentially
+ *   unsigned integers as LEB128 varints, signed ones zigzag-mapped first; floating point raw, in host byte order
+ *   bit fields of a fixed width packed low bit first, each run of them padded to a byte by align
+ * a whole scheme goes behind a header of MAGIC, VERSION, the kind of the scheme, a fingerprint of its id and
+ * parameters, and whether it counted bytes, so a blob is only read back into a scheme of the same kind and
+ * parameters counting the same, whatever built either */
+namespace codec {
+    constexpr static const uint32_t MAGIC = 0x4B534E57;
+    // bumped on every change of any counter's layout
+    constexpr static const uint32_t VERSION = 2;
+
+    class writer {
+        vector<BYTE>& out;
+        uint64_t acc = 0;
+        int fill = 0;
+    public:
+        explicit writer(vector<BYTE>& o) : out(o) {}
+
+        void varint(uint64_t v) {
+            for(; v >= 0x80; v >>= 7)
+                out.push_back(BYTE(v) | 0x80);
+            out.push_back(BYTE(v));
+        }
+        void zigzag(int64_t v) {
+            varint((uint64_t(v) << 1) ^ uint64_t(v >> 63));
+        }
+        template<typename T>
+        void raw(const T& v) {
+            static_assert(is_trivially_copyable_v<T>);
+            auto p = reinterpret_cast<const BYTE*>(&v);
+            out.insert(out.end(), p, p + sizeof(T));
+        }
+        // the low width bits of v, width at most 32
+        void bits(uint32_t v, int width) {
+            acc |= uint64_t(v & ((1ull << width) - 1)) << fill;
+            for(fill += width; fill >= 8; fill -= 8) {
+                out.push_back(BYTE(acc));
+                acc >>= 8;
+            }
+        }
+        void align() {
+            if(fill > 0)
+                out.push_back(BYTE(acc));
+            acc = 0;
+            fill = 0;
+        }
+    };
+
+    // reads what writer wrote; past the end or on a value out of range it fails, and from then on returns zeros
+    class reader {
+        span<const BYTE> in;
+        size_t pos = 0;
+        uint64_t acc = 0;
+        int fill = 0;
+        bool bad = false;
+    public:
+        explicit reader(span<const BYTE> i) : in(i) {}
+
+        bool failed() const { return bad; }
+        void fail() { bad = true; }
+        // bytes left
+        size_t remaining() const { return in.size() - pos; }
+
+        uint64_t varint() {
+            uint64_t v = 0;
+            for(int shift = 0; shift < 64 && pos < in.size(); shift += 7) {
+                BYTE b = in[pos++];
+                v |= uint64_t(b & 0x7F) << shift;
+                if(!(b & 0x80))
+                    return v;
+            }
+            bad = true;
+            return 0;
+        }
+        int64_t zigzag() {
+            uint64_t v = varint();
+            return int64_t(v >> 1) ^ -int64_t(v & 1);
+        }
+        // a varint of at most most
+        uint64_t bounded(uint64_t most) {
+            uint64_t v = varint();
+            if(v > most) [[unlikely]] {
+                bad = true;
+                return 0;
+            }
+            return v;
+        }
+        // a zigzag varint within [lo, hi]
+        int64_t within(int64_t lo, int64_t hi) {
+            int64_t v = zigzag();
+            if(v < lo || v > hi) [[unlikely]] {
+                bad = true;
+                return 0;
+            }
+            return v;
+        }
+        template<typename T>
+        T raw() {
+            static_assert(is_trivially_copyable_v<T>);
+            T v{};
+            if(remaining() < sizeof(T)) [[unlikely]] {
+                bad = true;
+                return v;
+            }
+            memcpy(&v, in.data() + pos, sizeof(T));
+            pos += sizeof(T);
+            return v;
+        }
+        uint32_t bits(int width) {
+            for(; fill < width; fill += 8) {
+                if(pos == in.size()) [[unlikely]] {
+                    bad = true;
+                    return 0;
+                }
+                acc |= uint64_t(in[pos++]) << fill;
+            }
+            uint32_t v = acc & ((1ull << width) - 1);
+            acc >>= width;
+            fill -= width;
+            return v;
+        }
+        void align() {
+            acc = 0;
+            fill = 0;
+        }
+    };
+
+    // FNV-1a of id, then of every value as 8 bytes low byte first
+    template<typename... V>
+    constexpr uint64_t fingerprint(string_view id, V... values) {
+        uint64_t h = 0xCBF29CE484222325;
+        auto mix = [&h](BYTE b) { h = (h ^ b) * 0x100000001B3; };
+        for(char c : id)
+            mix(BYTE(c));
+        ([&](uint64_t v) {
+            for(int i = 0; i < 8; i++, v >>= 8)
+                mix(BYTE(v));
+        }(uint64_t(values)), ...);
+        return h;
+    }
+    // the kind of scheme id at parameter set P with its own template arguments values: every compile-time
+    // constant its state depends on
+    template<typename P, typename... V>
+    constexpr uint64_t kind(string_view id, V... values) {
+        return fingerprint(id, P::FULL_WIDTH, P::SAMPLE_RATE, P::MAX_LENGTH, TIMESCALE, FULL_HEIGHT, values...);
+    }
+
+    // by_bytes: the scheme counted bytes rather than packets, which scales what some counters store
+    inline void header(writer& out, uint64_t kind, bool by_bytes) {
+        out.raw(MAGIC);
+        out.varint(VERSION);
+        out.raw(kind);
+        out.varint(by_bytes);
+    }
+    // false, with in failed, unless in starts with the header of kind and by_bytes
+    inline bool check_header(reader& in, uint64_t kind, bool by_bytes) {
+        if(in.raw<uint32_t>() != MAGIC || in.varint() != VERSION || in.raw<uint64_t>() != kind ||
+           in.varint() != uint64_t(by_bytes))
+            in.fail();
+        return !in.failed();
+    }
+}
+
+#endif //CODEC_H
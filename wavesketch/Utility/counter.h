@@ -1,29 +1,105 @@
 #ifndef COUNTER_H
 #define COUNTER_H
 
+#include <atomic>
+#include <ranges>
+
 #include "types.h"
+#include "arena.h"
+#include "codec.h"
 
 using namespace std;
 
-class abstract_counter {
-public:
+/* finished counter as kept in table history; read-only from then on */
+template<typename S>
+concept SealedCounter = is_trivially_copyable_v<S> && is_trivially_destructible_v<S> && requires(const S& s, HASH h) {
+    // rebuild counters in a period with timestamps, as a range of SAMPLE viewing the counter's own storage
+    requires ranges::input_range<decltype(s.rebuild(h))>;
+    requires convertible_to<ranges::range_reference_t<decltype(s.rebuild(h))>, SAMPLE>;
+    // return timestamp of first packet, inclusive
+    { s.start() } -> same_as<TIME>;
+    // serialize the contents in counter
+    { s.serialize() } -> same_as<size_t>;
+    // optionally, rebuild_range(h, first, last): the samples of rebuild(h) in times [first, last] only
+};
+
+// a counter C may declare a compact C::sealed, built by c.seal(row_arena) holding only live records and
+// allocating its rebuild cache from the same arena; otherwise history keeps plain copies of C
+template<typename C>
+struct sealed_of {
+    typedef C type;
+};
+template<typename C> requires requires { typename C::sealed; }
+struct sealed_of<C> {
+    typedef typename C::sealed type;
+};
+template<typename C>
+using sealed_t = typename sealed_of<C>::type;
+
+// a sealed counter S may also take a binary form (see codec.h): s.encode(out) writes all of it but the start time,
+// which its table codes, and S::decode(in, row_arena, start) reads it back into a counter rebuilding the same
+template<typename S>
+concept EncodableCounter = requires(const S& s, codec::writer& out, codec::reader& in, arena& a, TIME t) {
+    s.encode(out);
+    { S::decode(in, a, t) } -> same_as<S>;
+};
+
+// the rebuild cache of a sealed counter: n slots from home, filled by fill(slots) on first use. rebuilds may run
+// concurrently; racing first uses each fill their own slots, the first published wins and the rest stay unused
+template<typename T, typename F>
+T* cache_once(T*& cache, arena& home, size_t n, F&& fill) {
+    atomic_ref<T*> slot(cache);
+    T* result = slot.load(memory_order_acquire);
+    if(result != nullptr) [[likely]]
+        return result;
+    T* fresh = home.allocate_shared<T>(sizeof(T) * n);
+    fill(fresh);
+    if(slot.compare_exchange_strong(result, fresh, memory_order_acq_rel, memory_order_acquire))
+        return fresh;
+    return result;
+}
+
+// rebuilding parts of a counter of n values against building its whole rebuild cache, as ski rental: true while
+// the parts asked for so far, this one of the given cost included, cost no more than the cache would
+inline bool rent_part(uint32_t& spent, size_t cost, size_t n) {
+    return atomic_ref<uint32_t>(spent).fetch_add(cost, memory_order_relaxed) + cost <= n;
+}
+
+// true unless C declares STATIC_RANDOM: its counters then draw from a generator shared by every instance, so
+// counters of different rows cannot be updated from different threads
+template<typename C>
+constexpr bool row_local() {
+    if constexpr(requires { C::STATIC_RANDOM; })
+        return !C::STATIC_RANDOM;
+    else
+        return true;
+}
+
+/* counter interface, bound at compile time: tables store counters by value and call them directly */
+template<typename C>
+concept DerivedCounter = requires(C& c, const C& cc, TIME t, HASH h, DATA d) {
     // reset all related data structures; act as an empty counter afterward
-    virtual void reset() = 0;
+    c.reset();
     // count individual packet arriving at time t, return true only if full
-    virtual bool count(TIME t, HASH h, DATA c) = 0;
+    { c.count(t, h, d) } -> same_as<bool>;
     // finish recording and deal with remaining buffered data
-    virtual void flush() { };
-    // rebuild counters in a period with timestamps
-    virtual STREAM_QUEUE rebuild(HASH h) const = 0;
+    c.flush();
     // test if the counter is empty
-    virtual bool empty() const = 0;
+    { cc.empty() } -> same_as<bool>;
     // return timestamp of first packet, inclusive
-    virtual TIME start() const = 0;
+    { cc.start() } -> same_as<TIME>;
     // serialize the contents in counter
-    virtual size_t serialize() const = 0;
-};
+    { cc.serialize() } -> same_as<size_t>;
+} && SealedCounter<sealed_t<C>> && (same_as<sealed_t<C>, C> || requires(const C& c, arena& a) {
+    // copy the finished counter into a
+    { c.seal(a) } -> same_as<sealed_t<C>>;
+});
 
-template<typename C>
-concept DerivedCounter = std::is_base_of_v<abstract_counter, C>;
+// common base of counters: no virtual functions, so a counter is just its fields
+class abstract_counter {
+public:
+    // counters without buffered data have nothing to flush
+    void flush() { }
+};
 
 #endif //COUNTER_H
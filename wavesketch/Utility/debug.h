@@ -1,32 +1,77 @@
 #ifndef DEBUG_H
 #define DEBUG_H
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
 
 #include "five_tuple.h"
 
-/* preprocess */
-// #define SELECT_IN
-// #define SELECT_OUT
-// #define FILTER_LOW 20u
-#define FILE_IN ("/home/daniel/PaperRedes/volvieron las voces/uMon-WaveSketch/data/hadoop15.csv")
-#define FILE_OUT ("report.csv")
-#define FLOW_OUT ("sample.csv")
-//#define META_OUT ("meta_report.csv")
-//#define FILTER_TIME (500u * TIMESCALE)//25308
-//#define BY_BYTES 1
-
-static five_tuple breakpoint(2882);
-
-/* execution */
-#define USE_WAVE_IDEAL methods::WAVE_IDEAL
-#define USE_WAVE_PRACTICAL methods::WAVE_PRACTICAL
-#define USE_OMNIWINDOW methods::OMNIWINDOW
-//#define USE_NAIVE_CMS methods::NAIVE_CMS
-#define USE_FOURIER methods::FOURIER
-#define USE_PERSIST_CMS methods::PERSIST_CMS
-//#define USE_PERSIST_AMS methods::PERSIST_AMS
-//#define USE_WAVE_ALT_I methods::WAVE_ALT_I
-//#define USE_WAVE_ALT_P methods::WAVE_ALT_P
+using namespace std;
+
+/* runtime options, filled from the command line and config files (see config.h) */
+struct options {
+    /* preprocess */
+    // keep only flows sharing a half-width bucket with breakpoint, on input / on output
+    bool select_in = false;
+    bool select_out = false;
+    // skip flows shorter than this in the report, 0 to keep all
+    uint32_t filter_low = 0;
+    // score the reported flows against their ground truth into file_out; unset, on unless stream_in, which then
+    // has to keep every sample of those flows
+    optional<bool> evaluate;
+    string file_in = "data_source/hadoop15.csv";
+    // empty output names fall back to the standard streams
+    string file_out = "report.csv";
+    string flow_out = "sample.csv";
+    string meta_out = "";
+    // one line per scheme and memory budget, empty to disable
+    string summary_out = "";
+    // stop reading at the first packet at or after this time(ns), 0 to read all
+    uint64_t filter_time = 0;
+    // count bytes instead of packets
+    bool by_bytes = false;
+    // feed schemes while reading file_in instead of loading it; reorder_window packets absorb late timestamps
+    bool stream_in = false;
+    uint32_t reorder_window = 4096;
+
+    five_tuple breakpoint{2882};
+    // flow_out sums the breakpoint flow over windows of 2^flow_level ticks, as schemes aggregate it
+    uint32_t flow_level = 0;
+
+    /* execution */
+    vector<string> schemes = {"Wavelet-Ideal", "Wavelet-Practical", "OmniWindow", "Fourier", "Persist-CMS"};
+    // sketch dimensions, must match a compiled-in parameter set
+    uint32_t width = 32;
+    uint32_t rate = 32;
+    uint32_t length = 131072;
+    // run the schemes at every compiled-in parameter set of this length instead of width and rate only
+    bool sweep = false;
+    // schemes run concurrently on up to this many threads, 0 for one per independent scheme
+    uint32_t jobs = 0;
+    // each scheme rebuilds flows on up to this many threads, 0 for an equal share of the cores per concurrent scheme
+    uint32_t rebuild_jobs = 0;
+    // each scheme counts packets on up to this many threads, split by table rows, 0 for one per core
+    uint32_t ingest_jobs = 1;
+
+    // true if f shares a half-width bucket with breakpoint in a sketch of the given width
+    bool near_breakpoint(const five_tuple& f, uint32_t width) const {
+        uint32_t half_width = max(1u, width / 2u);
+        return f.hash() % half_width == breakpoint.hash() % half_width;
+    }
+    // true if the reported flows are scored
+    bool scoring() const {
+        return evaluate.value_or(!stream_in);
+    }
+    // true if the outputs may need every sample of f: the breakpoint, and the flows scoring reports at any width
+    bool reported(const five_tuple& f) const {
+        return f == breakpoint || (scoring() && (!select_out || sweep || near_breakpoint(f, width)));
+    }
+};
+
+inline options settings{};
 
 #endif //DEBUG_H
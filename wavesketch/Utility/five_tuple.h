@@ -9,6 +9,15 @@
 
 using namespace std;
 
+/* seed-independent part of five_tuple::hash: the key is mixed once, every seed only finalizes */
+struct flow_digest {
+    uint32_t mix;
+
+    size_t hash(uint32_t seed = 0xDEADBEEF) const {
+        return simple_hash_final(mix, 13, seed);
+    }
+};
+
 /* five tuple */
 struct five_tuple {
 
@@ -55,10 +64,11 @@ struct five_tuple {
         return result;
     }
 
+    flow_digest digest() const {
+        return {simple_hash_mix(this, 13)};
+    }
     size_t hash(uint32_t seed = 0xDEADBEEF) const {
-        size_t hash_value = 0;
-        simple_hash(this, 13, seed, &hash_value);
-        return hash_value;
+        return digest().hash(seed);
     }
 
     friend constexpr strong_ordering operator<=>(const five_tuple& lhs, const five_tuple& rhs) = default;
@@ -0,0 +1,259 @@
+#ifndef FLOW_MAP_H
+#define FLOW_MAP_H
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "five_tuple.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+/* open-addressing hash map keyed on five_tuple, in the manner of a swiss table
+ *   one control byte per slot, EMPTY or the low 7 bits of the key hash; a lookup matches 16 of them at once
+ *   and only compares keys whose stored 32-bit hash is equal, growing never rehashes a key
+ *   slots are probed by aligned groups of 16, triangularly, so a group load never wraps around
+ *   there is no erase: tables here only grow and are dropped whole
+ * flow_map<void> is a set of five_tuple */
+template<typename V>
+class flow_map {
+public:
+    typedef conditional_t<is_void_v<V>, five_tuple, pair<five_tuple, V>> value_type;
+private:
+    constexpr static const size_t GROUP = 16;
+    constexpr static const int8_t EMPTY = -128;
+
+    struct slot {
+        uint32_t hash;
+        value_type value;
+    };
+
+    unique_ptr<int8_t[]> ctrl{};
+    slot* slots = nullptr;
+    size_t capacity = 0;
+    size_t count = 0;
+
+    static const five_tuple& key(const value_type& v) {
+        if constexpr(is_void_v<V>)
+            return v;
+        else
+            return v.first;
+    }
+    static int8_t tag(uint32_t h) {
+        return h & 0x7F;
+    }
+    // bit i set if ctrl[base + i] == b
+    uint32_t match(size_t base, int8_t b) const {
+#if defined(__SSE2__)
+        __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl.get() + base));
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(b)));
+#else
+        uint32_t result = 0;
+        for(size_t i = 0; i < GROUP; i++)
+            result |= (uint32_t)(ctrl[base + i] == b) << i;
+        return result;
+#endif
+    }
+
+    // slot of f, or capacity if absent
+    size_t locate(const five_tuple& f, uint32_t h) const {
+        if(capacity == 0) [[unlikely]]
+            return 0;
+        const size_t mask = capacity / GROUP - 1;
+        for(size_t g = (h >> 7) & mask, step = 1;; g = (g + step++) & mask) {
+            const size_t base = g * GROUP;
+            for(uint32_t m = match(base, tag(h)); m != 0; m &= m - 1) {
+                size_t i = base + countr_zero(m);
+                if(slots[i].hash == h && key(slots[i].value) == f) [[likely]]
+                    return i;
+            }
+            if(match(base, EMPTY) != 0) [[likely]]
+                return capacity;
+        }
+    }
+    // first empty slot on the probe sequence of h
+    size_t vacancy(uint32_t h) const {
+        const size_t mask = capacity / GROUP - 1;
+        for(size_t g = (h >> 7) & mask, step = 1;; g = (g + step++) & mask) {
+            uint32_t m = match(g * GROUP, EMPTY);
+            if(m != 0) [[likely]]
+                return g * GROUP + countr_zero(m);
+        }
+    }
+    // make room for n entries at 7/8 load
+    void grow(size_t n) {
+        size_t target = GROUP;
+        while(target - target / 8 < n)
+            target *= 2;
+        if(target <= capacity)
+            return;
+
+        auto old_ctrl = move(ctrl);
+        slot* old_slots = slots;
+        size_t old_capacity = capacity;
+
+        ctrl = make_unique_for_overwrite<int8_t[]>(target);
+        memset(ctrl.get(), EMPTY, target);
+        slots = static_cast<slot*>(::operator new(sizeof(slot) * target, align_val_t(alignof(slot))));
+        capacity = target;
+        for(size_t i = 0; i < old_capacity; i++)
+            if(old_ctrl[i] != EMPTY) {
+                size_t j = vacancy(old_slots[i].hash);
+                ctrl[j] = old_ctrl[i];
+                new(&slots[j]) slot(move(old_slots[i]));
+                old_slots[i].~slot();
+            }
+        ::operator delete(old_slots, align_val_t(alignof(slot)));
+    }
+    template<typename... A>
+    size_t emplace_at(uint32_t h, A&&... args) {
+        grow(count + 1);
+        size_t i = vacancy(h);
+        ctrl[i] = tag(h);
+        new(&slots[i]) slot{h, value_type(forward<A>(args)...)};
+        count++;
+        return i;
+    }
+    void destroy() {
+        for(size_t i = 0; i < capacity; i++)
+            if(ctrl[i] != EMPTY)
+                slots[i].~slot();
+        ::operator delete(slots, align_val_t(alignof(slot)));
+        ctrl.reset();
+        slots = nullptr;
+        capacity = count = 0;
+    }
+
+    template<bool CONST>
+    class basic_iterator {
+        typedef conditional_t<CONST, const flow_map, flow_map> owner;
+        owner* m;
+        size_t pos;
+
+        void skip() {
+            while(pos < m->capacity && m->ctrl[pos] == EMPTY)
+                pos++;
+        }
+    public:
+        using iterator_category = forward_iterator_tag;
+        using value_type = flow_map::value_type;
+        using difference_type = ptrdiff_t;
+        using pointer = conditional_t<CONST, const value_type*, value_type*>;
+        using reference = conditional_t<CONST, const value_type&, value_type&>;
+
+        basic_iterator() : m(nullptr), pos(0) {}
+        basic_iterator(owner* o, size_t p, bool advance = false) : m(o), pos(p) {
+            if(advance)
+                skip();
+        }
+        operator basic_iterator<true>() const { return {m, pos}; }
+
+        reference operator*() const { return m->slots[pos].value; }
+        pointer operator->() const { return &m->slots[pos].value; }
+        basic_iterator& operator++() { pos++; skip(); return *this; }
+        basic_iterator operator++(int) { basic_iterator old = *this; ++*this; return old; }
+        friend bool operator==(const basic_iterator& lhs, const basic_iterator& rhs) { return lhs.pos == rhs.pos; }
+    };
+public:
+    typedef basic_iterator<false> iterator;
+    typedef basic_iterator<true> const_iterator;
+
+    flow_map() = default;
+    flow_map(const flow_map& other) {
+        *this = other;
+    }
+    flow_map(flow_map&& other) noexcept {
+        *this = move(other);
+    }
+    flow_map& operator=(const flow_map& other) {
+        if(this == &other)
+            return *this;
+        clear();
+        grow(other.count);
+        for(size_t i = 0; i < other.capacity; i++)
+            if(other.ctrl[i] != EMPTY)
+                emplace_at(other.slots[i].hash, other.slots[i].value);
+        return *this;
+    }
+    flow_map& operator=(flow_map&& other) noexcept {
+        if(this == &other)
+            return *this;
+        destroy();
+        ctrl = move(other.ctrl);
+        slots = exchange(other.slots, nullptr);
+        capacity = exchange(other.capacity, 0);
+        count = exchange(other.count, 0);
+        return *this;
+    }
+    ~flow_map() {
+        destroy();
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    void reserve(size_t n) { grow(n); }
+    // drop every entry, keep the room
+    void clear() {
+        for(size_t i = 0; i < capacity; i++)
+            if(ctrl[i] != EMPTY) {
+                slots[i].~slot();
+                ctrl[i] = EMPTY;
+            }
+        count = 0;
+    }
+
+    iterator begin() { return {this, 0, true}; }
+    iterator end() { return {this, capacity}; }
+    const_iterator begin() const { return {this, 0, true}; }
+    const_iterator end() const { return {this, capacity}; }
+
+    // d is f.digest(), for callers that hashed f already
+    iterator find(const five_tuple& f, flow_digest d) { return {this, locate(f, d.hash())}; }
+    const_iterator find(const five_tuple& f, flow_digest d) const { return {this, locate(f, d.hash())}; }
+    iterator find(const five_tuple& f) { return find(f, f.digest()); }
+    const_iterator find(const five_tuple& f) const { return find(f, f.digest()); }
+    bool contains(const five_tuple& f) const { return find(f) != end(); }
+
+    pair<iterator, bool> insert(const value_type& v) {
+        uint32_t h = key(v).hash();
+        size_t i = locate(key(v), h);
+        if(i != capacity)
+            return {{this, i}, false};
+        return {{this, emplace_at(h, v)}, true};
+    }
+
+    // the value of f, default-constructed if f is new
+    template<typename U = V> requires (!is_void_v<U>)
+    U& get(const five_tuple& f, flow_digest d) {
+        uint32_t h = d.hash();
+        size_t i = locate(f, h);
+        if(i == capacity)
+            i = emplace_at(h, piecewise_construct, forward_as_tuple(f), forward_as_tuple());
+        return slots[i].value.second;
+    }
+    template<typename U = V> requires (!is_void_v<U>)
+    U& operator[](const five_tuple& f) {
+        return get(f, f.digest());
+    }
+    template<typename U = V> requires (!is_void_v<U>)
+    const U& at(const five_tuple& f) const {
+        auto it = find(f);
+        if(it == end()) [[unlikely]]
+            throw out_of_range("flow_map::at");
+        return it->second;
+    }
+};
+
+typedef flow_map<void> flow_set;
+
+#endif //FLOW_MAP_H
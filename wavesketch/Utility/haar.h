@@ -0,0 +1,211 @@
+#ifndef HAAR_H
+#define HAAR_H
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "types.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAAR_X86
+#endif
+
+using namespace std;
+
+/* inverse of the integer haar transform the wavelet counters keep, bit-identical to applying
+ *   lo, hi = (lo + hi) / 2, (lo - hi) / 2
+ * to every pair in place, level by level from the top
+ *   in place, level i pairs the values at k * 2^(i+1) and k * 2^(i+1) + 2^i while the pair ends within n
+ *   here, the values at multiples of 2^i are gathered into one approximation column per level, so every level
+ *   is a contiguous merge of approximations and details into the approximations of the level below
+ * merge kernels are picked once from the cpu features (avx2, 8 pairs per step); other cpus use the scalar one */
+namespace haar {
+    /* scalar */
+    // out[2k] = (a[k] + d[k]) / 2, out[2k + 1] = (a[k] - d[k]) / 2 for k in [0, n)
+    inline void merge_scalar(const DATA* a, const DATA* d, size_t n, DATA* out) {
+        for(size_t k = 0; k < n; k++) {
+            DATA l = (a[k] + d[k]) / 2;
+            DATA h = (a[k] - d[k]) / 2;
+            out[2 * k] = l;
+            out[2 * k + 1] = h;
+        }
+    }
+
+#ifdef HAAR_X86
+    /* avx2 */
+    // x / 2 rounded toward zero: negative odd x gets one added before the arithmetic shift
+    __attribute__((target("avx2")))
+    inline __m256i half8(__m256i x) {
+        return _mm256_srai_epi32(_mm256_add_epi32(x, _mm256_srli_epi32(x, 31)), 1);
+    }
+    __attribute__((target("avx2")))
+    inline void merge_avx2(const DATA* a, const DATA* d, size_t n, DATA* out) {
+        static_assert(sizeof(DATA) == 4);
+        size_t k = 0;
+        for(; k + 8 <= n; k += 8) {
+            __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + k));
+            __m256i vd = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(d + k));
+            __m256i l = half8(_mm256_add_epi32(va, vd));
+            __m256i h = half8(_mm256_sub_epi32(va, vd));
+            // l0 h0 l1 h1 | l4 h4 l5 h5 and l2 h2 l3 h3 | l6 h6 l7 h7, then the lanes in order
+            __m256i p = _mm256_unpacklo_epi32(l, h);
+            __m256i q = _mm256_unpackhi_epi32(l, h);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 2 * k), _mm256_permute2x128_si256(p, q, 0x20));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 2 * k + 8), _mm256_permute2x128_si256(p, q, 0x31));
+        }
+        merge_scalar(a + k, d + k, n - k, out + 2 * k);
+    }
+#endif
+
+    struct kernels {
+        const char* name;
+        void (*merge)(const DATA*, const DATA*, size_t, DATA*);
+    };
+    constexpr static const kernels scalar = {"scalar", merge_scalar};
+
+    inline kernels detect() {
+#ifdef HAAR_X86
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2"))
+            return {"avx2", merge_avx2};
+#endif
+        return scalar;
+    }
+    inline const kernels active = detect();
+
+    // invert the first n values of x, transformed over levels levels, in place
+    inline void inverse(DATA* x, size_t n, int levels, const kernels& use = active) {
+        if(n < 2)
+            return;
+        thread_local vector<DATA> approx, next, detail;
+        // values at multiples of 2^i before x ends
+        auto count = [n](int i) { return ((n - 1) >> i) + 1; };
+
+        approx.resize(count(levels));
+        for(size_t m = 0; m < approx.size(); m++)
+            approx[m] = x[m << levels];
+        for(int i = levels - 1; i >= 0; i--) {
+            // pairs ending within n, then at most one approximation and one detail left untouched
+            const size_t pairs = n >> (i + 1), size = count(i);
+            detail.resize(pairs);
+            for(size_t k = 0; k < pairs; k++)
+                detail[k] = x[(2 * k + 1) << i];
+
+            DATA* to = x;
+            if(i > 0) {
+                next.resize(size);
+                to = next.data();
+            }
+            use.merge(approx.data(), detail.data(), pairs, to);
+            if(size > 2 * pairs)
+                to[2 * pairs] = approx[pairs];
+            if(size > 2 * pairs + 1)
+                to[2 * pairs + 1] = x[(2 * pairs + 1) << i];
+            if(i > 0)
+                swap(approx, next);
+        }
+    }
+
+    // a coefficient of a transform at its place in the in-place layout; places left out hold zero
+    struct coefficient {
+        uint32_t pos;
+        DATA value;
+    };
+
+    /* values [first, last] of the first n values, transformed over levels levels, into out[0, last - first]
+     * from its coefficients alone, where a later one replaces an earlier one at the same place; the same
+     * operations as inverse, on the pairs above a wanted value only: O(coefs.size() + last - first + levels) */
+    inline void inverse_range(span<const coefficient> coefs, size_t n, int levels, size_t first, size_t last,
+                              DATA* out) {
+        // level i keeps a window of indices m, value m * 2^i: the details of level i pair with approximations
+        // [first >> (i + 1), last >> (i + 1)], so their odd indices span the even-aligned window below
+        // level levels keeps the top approximations [first >> levels, last >> levels]
+        auto low = [=](int i) -> size_t { return i == levels ? first >> i : (first >> (i + 1)) << 1; };
+        auto high = [=](int i) -> size_t { return i == levels ? last >> i : ((last >> (i + 1)) << 1) + 1; };
+        thread_local vector<size_t> offset;
+        thread_local vector<DATA> window, approx, next;
+        offset.resize(levels + 2);
+        offset[0] = 0;
+        for(int i = 0; i <= levels; i++)
+            offset[i + 1] = offset[i] + high(i) - low(i) + 1;
+        window.assign(offset[levels + 1], 0);
+
+        for(auto& c : coefs) {
+            int i = c.pos == 0 ? levels : min(countr_zero(c.pos), levels);
+            size_t m = c.pos >> i;
+            if(m >= low(i) && m <= high(i))
+                window[offset[i] + m - low(i)] = c.value;
+        }
+        auto at = [&](int i, size_t m) { return window[offset[i] + m - low(i)]; };
+
+        approx.assign(window.begin() + offset[levels], window.begin() + offset[levels + 1]);
+        for(int i = levels - 1; i >= 0; i--) {
+            // approximations of level i + 1 from index first >> (i + 1), into those of level i from first >> i
+            const size_t from = first >> (i + 1), to = first >> i;
+            next.resize((last >> i) - to + 1);
+            for(size_t m = to; m <= last >> i; m++) {
+                const size_t k = m >> 1;
+                const DATA a = approx[k - from];
+                if((k + 1) << (i + 1) <= n) {
+                    const DATA d = at(i, 2 * k + 1);
+                    next[m - to] = m & 1 ? (a - d) / 2 : (a + d) / 2;
+                } else
+                    next[m - to] = m & 1 ? at(i, m) : a;
+            }
+            swap(approx, next);
+        }
+        copy(approx.begin(), approx.end(), out);
+    }
+
+    /* for every x of xs, at most n, the sum of the first x values into out, from the coefficients as for
+     * inverse_range: an approximation of level i is the sum of the 2^i values below it, so the prefix [0, x) is
+     * the whole top blocks before x and, on the way down to x, every left half that x passes to the right of.
+     * the halves come from the same operations as inverse: O(levels log coefs.size()) per x, after sorting the
+     * coefficients and summing the top blocks once */
+    inline void prefix_sums(span<const coefficient> coefs, size_t n, int levels, span<const size_t> xs, DATA* out) {
+        // sorted by place, the last of equal places kept
+        thread_local vector<coefficient> sorted;
+        sorted.assign(coefs.begin(), coefs.end());
+        stable_sort(sorted.begin(), sorted.end(), [](auto& l, auto& r) { return l.pos < r.pos; });
+        auto last = unique(sorted.rbegin(), sorted.rend(), [](auto& l, auto& r) { return l.pos == r.pos; });
+        sorted.erase(sorted.begin(), last.base());
+        auto at = [](size_t pos) -> DATA {
+            auto it = lower_bound(sorted.begin(), sorted.end(), pos, [](auto& c, size_t p) { return c.pos < p; });
+            return it != sorted.end() && it->pos == pos ? it->value : 0;
+        };
+
+        // tops[m], the sum of the top blocks before block m
+        thread_local vector<DATA> tops;
+        tops.assign((n >> levels) + 1, 0);
+        for(size_t m = 1; m < tops.size(); m++)
+            tops[m] = tops[m - 1] + at((m - 1) << levels);
+
+        for(size_t j = 0; j < xs.size(); j++) {
+            const size_t x = xs[j];
+            DATA sum = tops[x >> levels];
+            DATA a = at((x >> levels) << levels);
+            for(int i = levels - 1; i >= 0 && (x & ((2u << i) - 1)) != 0; i--) {
+                const size_t b = (x >> (i + 1)) << (i + 1);
+                DATA lo = a, hi = at(b + (1 << i));
+                if(b + (2 << i) <= n) {
+                    const DATA d = hi;
+                    lo = (a + d) / 2;
+                    hi = (a - d) / 2;
+                }
+                if((x >> i) & 1) {
+                    sum += lo;
+                    a = hi;
+                } else
+                    a = lo;
+            }
+            out[j] = sum;
+        }
+    }
+}
+
+#endif //HAAR_H
@@ -0,0 +1,85 @@
+#ifndef HASH_SIMD_H
+#define HASH_SIMD_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "five_tuple.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HASH_SIMD_X86
+#endif
+
+using namespace std;
+
+/* vectorized five_tuple hashing, bit-identical to five_tuple::digest
+ *   digest_batch: digests of many keys, 8 keys per step (avx2)
+ * the kernel is picked once from the cpu features; other cpus use the scalar one.
+ * the per-row hashes of a digest stay scalar: the tables inline them, which beats a dispatched kernel */
+namespace hash_simd {
+    constexpr static const uint32_t M = 0x5bd1e995;
+
+    /* scalar */
+    inline void digest_scalar(const five_tuple* keys, size_t n, flow_digest* out) {
+        for(size_t i = 0; i < n; i++)
+            out[i] = keys[i].digest();
+    }
+
+#ifdef HASH_SIMD_X86
+    /* avx2 */
+    __attribute__((target("avx2")))
+    inline __m256i mix_word(__m256i k, __m256i m) {
+        k = _mm256_mullo_epi32(k, m);
+        k = _mm256_xor_si256(k, _mm256_srli_epi32(k, 24));
+        return _mm256_mullo_epi32(k, m);
+    }
+    // simple_hash_mix of keys[0..8): three words, then the one-byte tail read from key + 1
+    __attribute__((target("avx2")))
+    inline __m256i mix8(const five_tuple* keys) {
+        static_assert(sizeof(five_tuple) == 16);
+        const __m256i m = _mm256_set1_epi32(M);
+        const __m256i index = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+        auto base = reinterpret_cast<const int*>(keys);
+        __m256i w0 = _mm256_i32gather_epi32(base, index, 4);
+        __m256i w1 = _mm256_i32gather_epi32(base + 1, index, 4);
+        __m256i w2 = _mm256_i32gather_epi32(base + 2, index, 4);
+        __m256i tail = _mm256_and_si256(_mm256_srli_epi32(w0, 8), _mm256_set1_epi32(0xFF));
+
+        __m256i h = _mm256_xor_si256(mix_word(w0, m), mix_word(w1, m));
+        h = _mm256_xor_si256(h, mix_word(w2, m));
+        return _mm256_xor_si256(h, _mm256_mullo_epi32(tail, m));
+    }
+    __attribute__((target("avx2")))
+    inline void digest_avx2(const five_tuple* keys, size_t n, flow_digest* out) {
+        static_assert(sizeof(flow_digest) == 4);
+        size_t i = 0;
+        for(; i + 8 <= n; i += 8)
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), mix8(keys + i));
+        digest_scalar(keys + i, n - i, out + i);
+    }
+#endif
+
+    struct kernels {
+        const char* name;
+        void (*digest)(const five_tuple*, size_t, flow_digest*);
+    };
+    constexpr static const kernels scalar = {"scalar", digest_scalar};
+
+    inline kernels detect() {
+#ifdef HASH_SIMD_X86
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2"))
+            return {"avx2", digest_avx2};
+#endif
+        return scalar;
+    }
+    inline const kernels active = detect();
+}
+
+// out[i] = keys[i].digest() for i in [0, n)
+inline void digest_batch(const five_tuple* keys, size_t n, flow_digest* out) {
+    hash_simd::active.digest(keys, n, out);
+}
+
+#endif //HASH_SIMD_H
@@ -4,12 +4,18 @@
 #include "parameter.h"
 #include "debug.h"
 #include "types.h"
+#include "sorted.h"
+#include "series.h"
 
 #include "five_tuple.h"
+#include "hash_simd.h"
+#include "haar.h"
+#include "codec.h"
 #include "heap.h"
 #include "counter.h"
 #include "table.h"
 #include "scheme.h"
+#include "parallel.h"
 
 #include "murmurhash3.h"
 #include "pffft.h"
@@ -17,6 +23,7 @@
 #include <algorithm>
 #include <array>
 #include <cassert>
+#include <charconv>
 #include <chrono>
 #include <cmath>
 #include <cstdint>
@@ -26,9 +33,11 @@
 #include <iterator>
 #include <limits>
 #include <list>
+#include <queue>
 #include <random>
 #include <regex>
 #include <set>
+#include <sstream>
 #include <string>
 #include <tuple>
 #include <unordered_map>
@@ -42,19 +42,34 @@ protected:
         push_heap(heap_data, heap_data + size, greater<>());
         return {};
     }
+    // what T compares by: its key() where it has one, else T itself
+    static auto key(const T& r) {
+        if constexpr(requires { r.key(); })
+            return r.key();
+        else
+            return r;
+    }
     T replace(T r) {
         const int last_idx = SIZE - 1;
         const int max_parent = HEAP_PARENT(last_idx);
         T old = heap_data[0];
-        if(old > r)
+        // the key of r holds for the whole sift, and each level reads the keys of its children once
+        const auto k = key(r);
+        if(key(old) > k)
             return r;
 
         int idx = 0;
         while(idx <= max_parent) {
             int child = HEAP_LEFT(idx);
-            if(child < last_idx && (heap_data[child] > heap_data[child + 1]))
-                child++;
-            if(r < heap_data[child])
+            auto least = key(heap_data[child]);
+            if(child < last_idx) {
+                const auto right = key(heap_data[child + 1]);
+                if(least > right) {
+                    child++;
+                    least = right;
+                }
+            }
+            if(k < least)
                 break;
             heap_data[idx] = heap_data[child];
             idx = child;
@@ -110,6 +125,7 @@ template<Serializable T, uint32_t SIZE>
 // a priority queue approximated by threshold-based array; when full, randomly evicts historical data
 class pseudo_heap : public abstract_heap<T> {
 protected:
+    constexpr static const uint32_t SEED = 0xAEABDC85;
     static mt19937 gen;
 
     T push_hi(T r) {
@@ -146,6 +162,10 @@ public:
     static T thresh_lo;
 
     pseudo_heap() = default;
+    // restart the generator every pseudo_heap of this type evicts through, as at program start
+    static void reseed() {
+        gen.seed(SEED);
+    }
     void reset() {
         size_hi = 0;
         size_lo = SIZE - 1;
@@ -189,7 +209,7 @@ public:
 };
 
 template<Serializable T, uint32_t SIZE>
-mt19937 pseudo_heap<T, SIZE>::gen(0xAEABDC85);
+mt19937 pseudo_heap<T, SIZE>::gen(SEED);
 template<Serializable T, uint32_t SIZE>
 T pseudo_heap<T, SIZE>::thresh_hi{};//740, 49};
 template<Serializable T, uint32_t SIZE>
@@ -66,11 +66,12 @@ void FORCE_INLINE print_hex(const void *data, int len) {
     std::cout << std::dec << std::endl;
 }
 
-void FORCE_INLINE simple_hash(const void *key, int len, int seed, void *out) {
+// simple_hash xors every mixed word into seed ^ len, so the mixing does not depend on the seed:
+// simple_hash(key, len, seed) == simple_hash_final(simple_hash_mix(key, len), len, seed)
+uint32_t FORCE_INLINE simple_hash_mix(const void *key, int len) {
     const uint32_t m = 0x5bd1e995;
     const int r = 24;
-    const uint8_t *data = static_cast<const uint8_t *>(key);
-    uint32_t hash = seed ^ len;
+    uint32_t hash = 0;
     const uint32_t *ptr = static_cast<const uint32_t *>(key);
 
     while (len >= 4) {
@@ -95,12 +96,21 @@ void FORCE_INLINE simple_hash(const void *key, int len, int seed, void *out) {
             k *= m;
             hash ^= k;
     }
+    return hash;
+}
+
+uint32_t FORCE_INLINE simple_hash_final(uint32_t mix, int len, int seed) {
+    const uint32_t m = 0x5bd1e995;
+    uint32_t hash = (seed ^ len) ^ mix;
 
     hash ^= hash >> 13;
     hash *= m;
     hash ^= hash >> 15;
+    return hash;
+}
 
-    *static_cast<uint32_t *>(out) = hash;
+void FORCE_INLINE simple_hash(const void *key, int len, int seed, void *out) {
+    *static_cast<uint32_t *>(out) = simple_hash_final(simple_hash_mix(key, len), len, seed);
 }
 
 
@@ -0,0 +1,150 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <span>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// number of worker threads used by data-parallel helpers
+inline unsigned worker_count() {
+    unsigned n = thread::hardware_concurrency();
+    return n > 0 ? n : 1;
+}
+
+// cpu time of the calling thread: timings stay per-task when workers outnumber cores
+struct thread_clock {
+    typedef chrono::nanoseconds duration;
+    typedef duration::rep rep;
+    typedef duration::period period;
+    typedef chrono::time_point<thread_clock> time_point;
+    constexpr static const bool is_steady = true;
+
+    static time_point now() noexcept {
+        timespec ts{};
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return time_point(duration(ts.tv_sec * 1000000000ll + ts.tv_nsec));
+    }
+};
+
+// run f(i) for every i in [0, n), each on its own thread; the calling thread takes the last one
+template<typename F>
+void parallel_for(unsigned n, F&& f) {
+    if(n == 0) [[unlikely]]
+        return;
+
+    vector<thread> workers;
+    workers.reserve(n - 1);
+    for(unsigned i = 0; i + 1 < n; i++)
+        workers.emplace_back([&f, i]() { f(i); });
+    f(n - 1);
+
+    for(auto& w : workers)
+        w.join();
+}
+
+// run f(i) for every i in [0, n) on at most workers threads (0 for one per task), claiming tasks in order
+template<typename F>
+void parallel_tasks(size_t n, unsigned workers, F&& f) {
+    if(workers == 0 || workers > n)
+        workers = n;
+    atomic<size_t> next{0};
+    parallel_for(workers, [&](unsigned) {
+        for(size_t i = next++; i < n; i = next++)
+            f(i);
+    });
+}
+
+// run f(i) for every i in [0, n) on at most workers threads (0 for one per core), handing out blocks of grain
+// indices in order: a thread that finishes early claims the next block, so uneven tasks even out
+template<typename F>
+void parallel_blocks(size_t n, unsigned workers, size_t grain, F&& f) {
+    if(workers == 0)
+        workers = worker_count();
+    const size_t blocks = (n + grain - 1) / grain;
+    if(workers == 1 || blocks <= 1) {
+        for(size_t i = 0; i < n; i++)
+            f(i);
+        return;
+    }
+    parallel_tasks(blocks, workers, [&](size_t b) {
+        for(size_t i = b * grain; i < n && i < (b + 1) * grain; i++)
+            f(i);
+    });
+}
+
+/* a fixed team of threads that each run job(member, batch) on every batch published, in publishing order
+ *   batches are copied into a ring of SLOTS slots, so publish returns at once unless the slowest member is a
+ *   full ring behind; a slot is refilled only after every member is done with it. one thread publishes */
+template<typename T>
+class broadcast_ring {
+    constexpr static const uint64_t SLOTS = 8;
+
+    vector<T> slots[SLOTS]{};
+    // batches published
+    atomic<uint64_t> head{0};
+    // batches each member is done with
+    unique_ptr<atomic<uint64_t>[]> tails;
+    atomic<bool> stopping{false};
+    function<void(unsigned, span<const T>)> job;
+    vector<thread> team{};
+
+    void run(unsigned member) {
+        for(uint64_t next = 0;; next++) {
+            uint64_t h;
+            while((h = head.load(memory_order_acquire)) == next)
+                head.wait(h, memory_order_acquire);
+            if(stopping.load(memory_order_acquire))
+                return;
+            job(member, slots[next % SLOTS]);
+            tails[member].store(next + 1, memory_order_release);
+            tails[member].notify_one();
+        }
+    }
+    // wait until every member is done with the first done batches
+    void wait_for(uint64_t done) {
+        for(unsigned i = 0; i < team.size(); i++) {
+            uint64_t t;
+            while((t = tails[i].load(memory_order_acquire)) < done)
+                tails[i].wait(t, memory_order_acquire);
+        }
+    }
+public:
+    broadcast_ring(unsigned members, function<void(unsigned, span<const T>)> f)
+            : tails(make_unique<atomic<uint64_t>[]>(members)), job(move(f)) {
+        team.reserve(members);
+        for(unsigned i = 0; i < members; i++)
+            team.emplace_back([this, i]() { run(i); });
+    }
+    broadcast_ring(const broadcast_ring&) = delete;
+    broadcast_ring& operator=(const broadcast_ring&) = delete;
+    ~broadcast_ring() {
+        drain();
+        stopping.store(true, memory_order_release);
+        head.fetch_add(1, memory_order_release);
+        head.notify_all();
+        for(auto& t : team)
+            t.join();
+    }
+
+    void publish(span<const T> batch) {
+        uint64_t h = head.load(memory_order_relaxed);
+        if(h >= SLOTS)
+            wait_for(h - SLOTS + 1);
+        slots[h % SLOTS].assign(batch.begin(), batch.end());
+        head.store(h + 1, memory_order_release);
+        head.notify_all();
+    }
+    // wait until every published batch is done
+    void drain() {
+        wait_for(head.load(memory_order_relaxed));
+    }
+};
+
+#endif //PARALLEL_H
@@ -3,6 +3,7 @@
 
 #include <algorithm>
 #include <bit>
+#include <cstdint>
 
 // scale for input time(ns)
 #define TIMESCALE 8192u
@@ -10,34 +11,45 @@
 #define SQRT2F 1.4140625f
 #define SQRT2B 0b00110101
 #define NOSQRT 0b10000000
-// one object can process data in MAX_LENGTH * TIMESCALE ns
-#define MAX_LENGTH 131072u
-// process data to the third top level, inclusive
-#define LEVEL (countr_zero(MAX_LENGTH) - 3)
-#define INDEX_MASK ((1u << LEVEL) - 1)
-// maximum of data stored in heaps
-#define SAMPLE_RATE 32u
-// #define HIST_SIZE (MAX_LENGTH / SAMPLE_RATE)
 // data in second top level
 #define RESERVED 8u
-// table dimensions
-#define FULL_WIDTH 32u
-#define HALF_WIDTH (FULL_WIDTH / 2u)
+// table heights
 #define FULL_HEIGHT 3u
 #define LESS_HEIGHT (FULL_HEIGHT - 1u)
 #define PAIR_HEIGHT 2u
-#define FULL_DEPTH (MAX_LENGTH / SAMPLE_RATE)
 //#define WAVE_DEPTH 55u
 //#define PAMS_DEPTH 24u
-#define PCMS_DELTA (SAMPLE_RATE * 2)
 #define ROUND(a, b) ((a) / (b) + (((b) & 1) == 0 ? (a) % (b) >= (b) / 2 : (a) % (b) > (b) / 2))
-
-#define BUCKET (FULL_WIDTH * FULL_HEIGHT)
-#define MEMORY (FULL_WIDTH * FULL_HEIGHT * FULL_DEPTH * 4)
-// window for FFT
-#define WINDOW (max(32u, bit_ceil(SAMPLE_RATE) * 2u))
 // score multiplier for stored flow
 #define HIT_RATIO 8u
-#define RETAIN_THRESH (FULL_DEPTH * 4u)
+
+// performance-critical sketch dimensions, fixed at compile time for every scheme instantiation
+template<uint32_t WIDTH = 32u, uint32_t RATE = 32u, uint32_t LENGTH = 131072u>
+struct parameter {
+    // one object can process data in MAX_LENGTH * TIMESCALE ns
+    constexpr static const uint32_t MAX_LENGTH = LENGTH;
+    // process data to the third top level, inclusive
+    constexpr static const int LEVEL = std::countr_zero(MAX_LENGTH) - 3;
+    constexpr static const uint32_t INDEX_MASK = (1u << LEVEL) - 1;
+    // maximum of data stored in heaps
+    constexpr static const uint32_t SAMPLE_RATE = RATE;
+    // constexpr static const uint32_t HIST_SIZE = MAX_LENGTH / SAMPLE_RATE;
+    // table dimensions
+    constexpr static const uint32_t FULL_WIDTH = WIDTH;
+    constexpr static const uint32_t HALF_WIDTH = FULL_WIDTH / 2u;
+    constexpr static const uint32_t FULL_DEPTH = MAX_LENGTH / SAMPLE_RATE;
+    constexpr static const uint32_t PCMS_DELTA = SAMPLE_RATE * 2;
+
+    constexpr static const uint32_t BUCKET = FULL_WIDTH * FULL_HEIGHT;
+    constexpr static const uint32_t MEMORY = FULL_WIDTH * FULL_HEIGHT * FULL_DEPTH * 4;
+    // window for FFT
+    constexpr static const uint32_t WINDOW = std::max(32u, std::bit_ceil(SAMPLE_RATE) * 2u);
+    constexpr static const uint32_t RETAIN_THRESH = FULL_DEPTH * 4u;
+
+    static_assert(std::has_single_bit(MAX_LENGTH) && LEVEL > 0);
+    static_assert(MAX_LENGTH >> LEVEL == RESERVED);
+};
+
+typedef parameter<> default_parameter;
 
 #endif //PARAMETER_H
@@ -2,11 +2,18 @@
 #define SCHEME_H
 
 #include <array>
+#include <memory>
+#include <span>
 
 #include "types.h"
+#include "codec.h"
+#include "series.h"
+#include "debug.h"
+#include "parallel.h"
 
 using namespace std;
 
+/* type-erased scheme, only used at the driver boundary: one virtual call per batch or query */
 class abstract_scheme {
 protected:
     template<typename T, size_t N, size_t... Ints>
@@ -20,48 +27,224 @@ protected:
 public:
     // reset all related data structures
     virtual void reset() = 0;
-    // count individual packet arriving at time t
-    virtual void count(const five_tuple& f, const TIME t, const DATA c) = 0;
+    // count individual packet arriving at time t; d is f.digest(), shared by every row and table
+    virtual void count(const five_tuple& f, flow_digest d, const TIME t, const DATA c) = 0;
+    void count(const five_tuple& f, const TIME t, const DATA c) {
+        count(f, f.digest(), t, c);
+    }
+    // count every packet of batch in order, same result as calling count on each
+    virtual void count_batch(span<const packet> batch) {
+        for(auto& p : batch)
+            count(p.flow, p.digest, p.time, p.data);
+    }
+    // count_batch spread over up to workers threads (0 for one per core) that take disjoint parts of the
+    // sketch; may return before the batch is counted, wait, flush and reset wait for it
+    virtual void count_rows(span<const packet> batch, unsigned) {
+        count_batch(batch);
+    }
+    // block until every batch handed to count_rows is counted
+    virtual void wait() {}
     // finish recording and deal with remaining buffered data
     virtual void flush() = 0;
     // rebuild counters for a label-set in all available timestamps
     virtual STREAM rebuild(const STREAM& dict) const = 0;
+    // sums of every flow of dict over windows of 2^level ticks, clipped to its times in dict (see coarsen), as
+    // rebuild(known) answers them: known holds every flow of the input, which rebuild may take out of shared
+    // counters; by default rebuilt tick by tick and summed, or a scheme's window_estimate if it has one
+    virtual STREAM aggregate(const STREAM& dict, int level, const STREAM& known) const {
+        STREAM all = rebuild(known), result;
+        for(auto& [f, times] : dict) {
+            auto it = all.find(f);
+            result[f] = coarsen(it != all.end() ? it->second : STREAM_QUEUE{}, times.front().first,
+                                times.back().first, level);
+        }
+        return result;
+    }
+    // append the historic state to out in binary form (see codec.h), live counters left out: flush first; false
+    // if the scheme has none
+    virtual bool encode(vector<BYTE>&) const {
+        return false;
+    }
+    // replace the state by one encode of a scheme of the same kind wrote, after which rebuild answers as the
+    // encoded scheme's first rebuild did; false, with the scheme reset, on anything else
+    virtual bool decode(span<const BYTE>) {
+        return false;
+    }
     // serialize related data structures
     virtual size_t serialize() const = 0;
+    virtual ~abstract_scheme() = default;
+};
+
+// flows a rebuilding thread claims at a time
+constexpr static const size_t REBUILD_GRAIN = 64;
+
+// f(flow, queue) for every flow of dict on up to settings.rebuild_jobs threads, into the matching slot of the
+// result; f may only read shared state, as sealed counters do while rebuilding
+template<typename F>
+vector<pair<five_tuple, STREAM_QUEUE>> rebuild_flows(const STREAM& dict, F&& f) {
+    vector<const STREAM::value_type*> flows;
+    flows.reserve(dict.size());
+    for(auto& p : dict)
+        flows.push_back(&p);
+
+    vector<pair<five_tuple, STREAM_QUEUE>> result(flows.size());
+    parallel_blocks(flows.size(), settings.rebuild_jobs, REBUILD_GRAIN, [&](size_t i) {
+        result[i].first = flows[i]->first;
+        result[i].second = f(flows[i]->first, flows[i]->second);
+    });
+    return result;
+}
+
+/* scheme interface, bound at compile time; concrete schemes are not virtual
+ *   a scheme may also split its sketch into shards() parts that count_shard(s, batch) updates independently,
+ *   count_shard of every part in turn being count_batch */
+template<typename S>
+concept DerivedScheme = requires(S& s, const S& cs, const five_tuple& f, flow_digest d, TIME t, DATA c,
+                                 span<const packet> batch, const STREAM& dict) {
+    s.reset();
+    s.count(f, d, t, c);
+    s.count_batch(batch);
+    s.flush();
+    { cs.rebuild(dict) } -> same_as<STREAM>;
+    { cs.serialize() } -> same_as<size_t>;
 };
 
 template<DerivedTable T>
-class basic_scheme : public abstract_scheme {
+class basic_scheme {
 protected:
     T sketch{};
 public:
-    void reset() override {
+    void reset() {
         sketch.reset();
     }
 
-    void count(const five_tuple& f, const TIME t, const DATA c) override {
-        sketch.count(f, t, c);
+    void count(const five_tuple& f, flow_digest d, const TIME t, const DATA c) {
+        sketch.count(f, d, t, c);
+    }
+    void count_batch(span<const packet> batch) {
+        sketch.count_batch(batch);
     }
 
-    void flush() override {
+    void flush() {
         sketch.flush();
     }
 
-    STREAM rebuild(const STREAM& dict) const override {
-        STREAM result;
-        for(auto& p : dict)
-            result[p.first] = sketch.rebuild(p.first, p.second.front().first, p.second.back().first);
+    constexpr static size_t shards() {
+        return T::row_shards();
+    }
+    void count_shard(size_t s, span<const packet> batch) {
+        sketch.count_row(s, batch);
+    }
+
+    STREAM rebuild(const STREAM& dict) const {
+        auto queues = rebuild_flows(dict, [this](const five_tuple& f, const STREAM_QUEUE& q) {
+            return sketch.rebuild(f, q.front().first, q.back().first);
+        });
 
+        STREAM result;
+        result.reserve(queues.size());
+        for(auto& [f, q] : queues)
+            result[f] = move(q);
         return result;
     }
 
-    virtual size_t serialize() const override {
+    void encode(codec::writer& out) const requires requires(const T& t, codec::writer& w) { t.encode(w); } {
+        sketch.encode(out);
+    }
+    bool decode(codec::reader& in) requires requires(T& t, codec::reader& r) { t.decode(r); } {
+        return sketch.decode(in);
+    }
+
+    size_t serialize() const {
         return sketch.serialize();
     }
 };
 
-template<typename T>
-concept DerivedScheme = std::is_base_of_v<abstract_scheme, T>;
+// abstract_scheme over a concrete scheme S; everything below S's methods is resolved statically
+template<DerivedScheme S>
+class scheme_model final : public abstract_scheme {
+    S scheme{};
+    // workers of count_rows, started on first use: member m of a team of k counts shards m, m + k, ...;
+    // declared after scheme, so they are joined before it goes
+    unique_ptr<broadcast_ring<packet>> workers{};
+public:
+    void wait() override {
+        if(workers)
+            workers->drain();
+    }
+
+    void reset() override {
+        wait();
+        scheme.reset();
+    }
+
+    using abstract_scheme::count;
+    void count(const five_tuple& f, flow_digest d, const TIME t, const DATA c) override {
+        wait();
+        scheme.count(f, d, t, c);
+    }
+    void count_batch(span<const packet> batch) override {
+        wait();
+        scheme.count_batch(batch);
+    }
+    void count_rows(span<const packet> batch, unsigned n) override {
+        if constexpr(requires { requires S::shards() > 1; }) {
+            constexpr static const size_t SHARDS = S::shards();
+            const unsigned team = min<size_t>(n == 0 ? worker_count() : n, SHARDS);
+            if(team > 1) {
+                if(!workers) {
+                    workers = make_unique<broadcast_ring<packet>>(team, [this, team](unsigned m, span<const packet> b) {
+                        for(size_t s = m; s < SHARDS; s += team)
+                            scheme.count_shard(s, b);
+                    });
+                }
+                workers->publish(batch);
+                return;
+            }
+        }
+        count_batch(batch);
+    }
+
+    void flush() override {
+        wait();
+        scheme.flush();
+    }
+
+    STREAM rebuild(const STREAM& dict) const override {
+        return scheme.rebuild(dict);
+    }
+    // schemes that estimate the sums straight from their sketch answer with the estimate
+    STREAM aggregate(const STREAM& dict, int level, const STREAM& known) const override {
+        if constexpr(requires { { scheme.window_estimate(dict, level, known) } -> same_as<STREAM>; })
+            return scheme.window_estimate(dict, level, known);
+        else
+            return abstract_scheme::aggregate(dict, level, known);
+    }
+
+    bool encode(vector<BYTE>& out) const override {
+        if constexpr(requires(codec::writer& w) { scheme.encode(w); }) {
+            codec::writer w(out);
+            codec::header(w, S::KIND, settings.by_bytes);
+            scheme.encode(w);
+            return true;
+        } else
+            return false;
+    }
+    bool decode(span<const BYTE> in) override {
+        wait();
+        if constexpr(requires(codec::reader& r) { scheme.decode(r); }) {
+            codec::reader r(in);
+            if(codec::check_header(r, S::KIND, settings.by_bytes) && scheme.decode(r) && r.remaining() == 0)
+                return true;
+        }
+        scheme.reset();
+        return false;
+    }
+
+    size_t serialize() const override {
+        return scheme.serialize();
+    }
+};
 
 
 #endif //SCHEME_H
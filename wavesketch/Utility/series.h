@@ -0,0 +1,135 @@
+#ifndef SERIES_H
+#define SERIES_H
+
+#include <algorithm>
+#include <iterator>
+#include <span>
+#include <vector>
+
+#include "types.h"
+
+using namespace std;
+
+/* time series of one flow as a contiguous DATA column
+ *   dense while the times form a run with no gaps: value i is at start + i and no time is stored;
+ *   the first out-of-run push materializes a time column, which the series keeps from then on */
+class series {
+    TIME first = 0;
+    vector<TIME> times{};
+    vector<DATA> values{};
+
+    // switch to a stored time column
+    void index() {
+        times.resize(values.size());
+        for(size_t i = 0; i < times.size(); i++)
+            times[i] = first + i;
+    }
+public:
+    typedef SAMPLE value_type;
+
+    series() = default;
+    // dense run of n zero values from start
+    series(TIME start, size_t n) : first(start), values(n) {}
+
+    size_t size() const { return values.size(); }
+    bool empty() const { return values.empty(); }
+    bool dense() const { return times.empty(); }
+    void reserve(size_t n) {
+        values.reserve(n);
+        if(!dense())
+            times.reserve(n);
+    }
+    void clear() {
+        first = 0;
+        times.clear();
+        values.clear();
+    }
+
+    void push_back(TIME t, DATA d) {
+        if(values.empty())
+            first = t;
+        else if(dense() && t != first + values.size()) [[unlikely]]
+            index();
+        if(!dense())
+            times.push_back(t);
+        values.push_back(d);
+    }
+    void push_back(const value_type& v) {
+        push_back(v.first, v.second);
+    }
+    void pop_back() {
+        values.pop_back();
+        if(!dense())
+            times.pop_back();
+    }
+
+    TIME time(size_t i) const { return dense() ? first + i : times[i]; }
+    DATA& value(size_t i) { return values[i]; }
+    DATA value(size_t i) const { return values[i]; }
+    span<DATA> data() { return values; }
+    span<const DATA> data() const { return values; }
+
+    value_type operator[](size_t i) const { return {time(i), values[i]}; }
+    value_type front() const { return (*this)[0]; }
+    value_type back() const { return (*this)[size() - 1]; }
+
+    // the same times with every value zero
+    series zeros() const {
+        series result;
+        result.first = first;
+        result.times = times;
+        result.values.assign(values.size(), 0);
+        return result;
+    }
+
+    class iterator {
+        const series* s;
+        size_t pos;
+    public:
+        using iterator_category = random_access_iterator_tag;
+        using value_type = series::value_type;
+        using difference_type = ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        iterator() : s(nullptr), pos(0) {}
+        iterator(const series* q, size_t p) : s(q), pos(p) {}
+
+        value_type operator*() const { return (*s)[pos]; }
+        value_type operator[](difference_type n) const { return (*s)[pos + n]; }
+        iterator& operator++() { pos++; return *this; }
+        iterator operator++(int) { iterator old = *this; pos++; return old; }
+        iterator& operator--() { pos--; return *this; }
+        iterator operator--(int) { iterator old = *this; pos--; return old; }
+        iterator& operator+=(difference_type n) { pos += n; return *this; }
+        iterator& operator-=(difference_type n) { pos -= n; return *this; }
+        friend iterator operator+(iterator it, difference_type n) { return it += n; }
+        friend iterator operator+(difference_type n, iterator it) { return it += n; }
+        friend iterator operator-(iterator it, difference_type n) { return it -= n; }
+        friend difference_type operator-(const iterator& lhs, const iterator& rhs) { return lhs.pos - rhs.pos; }
+        friend bool operator==(const iterator& lhs, const iterator& rhs) { return lhs.pos == rhs.pos; }
+        friend auto operator<=>(const iterator& lhs, const iterator& rhs) { return lhs.pos <=> rhs.pos; }
+    };
+
+    iterator begin() const { return {this, 0}; }
+    iterator end() const { return {this, size()}; }
+};
+
+// sums of q over the windows of 2^level ticks aligned to multiples of 2^level from the window of first to that of
+// last, clipped to [first, last], as (window start, sum); windows without a sample sum to zero
+inline series coarsen(const series& q, TIME first, TIME last, int level) {
+    const TIME base = first >> level;
+    series result;
+    result.reserve((last >> level) - base + 1);
+    for(TIME w = base; w <= last >> level; w++)
+        result.push_back(w << level, 0);
+    for(size_t i = 0; i < q.size(); i++)
+        if(q.time(i) >= first && q.time(i) <= last)
+            result.value((q.time(i) >> level) - base) += q.value(i);
+    return result;
+}
+
+typedef series STREAM_QUEUE;
+typedef flow_map<STREAM_QUEUE> STREAM;
+
+#endif //SERIES_H
@@ -0,0 +1,184 @@
+#ifndef SORTED_H
+#define SORTED_H
+
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <tuple>
+#include <vector>
+
+#include "types.h"
+#include "parallel.h"
+#include "hash_simd.h"
+
+using namespace std;
+
+/* packets of a trace as contiguous flow / time / data columns */
+class sorted_trace {
+protected:
+    constexpr static const int RADIX_BITS = 8;
+    constexpr static const int RADIX = 1 << RADIX_BITS;
+    // smallest slice worth a thread of its own in the radix sort
+    constexpr static const size_t MIN_SLICE = 1u << 16;
+
+    template<typename T>
+    static void gather(vector<T>& column, const vector<uint32_t>& order) {
+        vector<T> result(column.size());
+        for(size_t i = 0; i < order.size(); i++)
+            result[i] = column[order[i]];
+        column.swap(result);
+    }
+public:
+    typedef tuple<five_tuple, TIME, DATA> value_type;
+
+    vector<five_tuple> flow{};
+    vector<TIME> time{};
+    vector<DATA> data{};
+    // flow[i].digest(), valid while hashed(); computed once so no scheme hashes the key again
+    vector<flow_digest> digest{};
+
+    size_t size() const { return time.size(); }
+    bool hashed() const { return digest.size() == size(); }
+    flow_digest digest_at(size_t i) const { return hashed() ? digest[i] : flow[i].digest(); }
+    bool empty() const { return time.empty(); }
+    void reserve(size_t n) {
+        flow.reserve(n);
+        time.reserve(n);
+        data.reserve(n);
+    }
+    void clear() {
+        flow.clear();
+        time.clear();
+        data.clear();
+        digest.clear();
+    }
+
+    void emplace_back(const five_tuple& f, TIME t, DATA d) {
+        flow.push_back(f);
+        time.push_back(t);
+        data.push_back(d);
+    }
+    void push_back(const value_type& v) {
+        emplace_back(get<0>(v), get<1>(v), get<2>(v));
+    }
+    template<typename C>
+    void append(const C& rows) {
+        reserve(size() + rows.size());
+        for(auto& v : rows)
+            push_back(v);
+    }
+
+    value_type operator[](size_t i) const {
+        return {flow[i], time[i], data[i]};
+    }
+    value_type front() const { return (*this)[0]; }
+    value_type back() const { return (*this)[size() - 1]; }
+
+    class iterator {
+        const sorted_trace* trace;
+        size_t pos;
+    public:
+        using iterator_category = random_access_iterator_tag;
+        using value_type = sorted_trace::value_type;
+        using difference_type = ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        iterator() : trace(nullptr), pos(0) {}
+        iterator(const sorted_trace* t, size_t p) : trace(t), pos(p) {}
+
+        value_type operator*() const { return (*trace)[pos]; }
+        value_type operator[](difference_type n) const { return (*trace)[pos + n]; }
+        iterator& operator++() { pos++; return *this; }
+        iterator operator++(int) { iterator old = *this; pos++; return old; }
+        iterator& operator--() { pos--; return *this; }
+        iterator operator--(int) { iterator old = *this; pos--; return old; }
+        iterator& operator+=(difference_type n) { pos += n; return *this; }
+        iterator& operator-=(difference_type n) { pos -= n; return *this; }
+        friend iterator operator+(iterator it, difference_type n) { return it += n; }
+        friend iterator operator+(difference_type n, iterator it) { return it += n; }
+        friend iterator operator-(iterator it, difference_type n) { return it -= n; }
+        friend difference_type operator-(const iterator& lhs, const iterator& rhs) { return lhs.pos - rhs.pos; }
+        friend bool operator==(const iterator& lhs, const iterator& rhs) { return lhs.pos == rhs.pos; }
+        friend auto operator<=>(const iterator& lhs, const iterator& rhs) { return lhs.pos <=> rhs.pos; }
+    };
+
+    iterator begin() const { return {this, 0}; }
+    iterator end() const { return {this, size()}; }
+
+    // stable parallel LSD radix sort on time; packets with equal time keep their order. return the row each row
+    // came from
+    vector<uint32_t> sort_by_time() {
+        const size_t n = size();
+        const unsigned slices = max<size_t>(1, min<size_t>(worker_count(), n / MIN_SLICE));
+
+        vector<TIME> keys = time;
+        vector<uint32_t> order(n);
+        for(size_t i = 0; i < n; i++)
+            order[i] = i;
+        vector<TIME> keys_out(n);
+        vector<uint32_t> order_out(n);
+        vector<array<size_t, RADIX>> offset(slices);
+
+        auto slice_lo = [&](unsigned s) { return n * s / slices; };
+        for(int shift = 0; shift < 32; shift += RADIX_BITS) {
+            // per-slice histograms of the current digit
+            parallel_for(slices, [&](unsigned s) {
+                offset[s].fill(0);
+                for(size_t i = slice_lo(s); i < slice_lo(s + 1); i++)
+                    offset[s][(keys[i] >> shift) & (RADIX - 1)]++;
+            });
+
+            // digit-major, slice-minor prefix sums keep the scatter stable
+            size_t sum = 0;
+            bool trivial = false;
+            for(int d = 0; d < RADIX; d++) {
+                size_t bucket = 0;
+                for(unsigned s = 0; s < slices; s++) {
+                    size_t c = offset[s][d];
+                    offset[s][d] = sum;
+                    sum += c;
+                    bucket += c;
+                }
+                if(bucket == n)
+                    trivial = true;
+            }
+            // every key shares this digit
+            if(trivial)
+                continue;
+
+            parallel_for(slices, [&](unsigned s) {
+                auto& o = offset[s];
+                for(size_t i = slice_lo(s); i < slice_lo(s + 1); i++) {
+                    size_t dst = o[(keys[i] >> shift) & (RADIX - 1)]++;
+                    keys_out[dst] = keys[i];
+                    order_out[dst] = order[i];
+                }
+            });
+            keys.swap(keys_out);
+            order.swap(order_out);
+        }
+
+        time.swap(keys);
+        gather(flow, order);
+        gather(data, order);
+        if(!digest.empty() && hashed())
+            gather(digest, order);
+        return order;
+    }
+
+    // fill the digest column
+    void hash_flows() {
+        const size_t n = size();
+        const unsigned slices = max<size_t>(1, min<size_t>(worker_count(), n / MIN_SLICE));
+        digest.resize(n);
+        parallel_for(slices, [&](unsigned s) {
+            size_t lo = n * s / slices, hi = n * (s + 1) / slices;
+            digest_batch(flow.data() + lo, hi - lo, digest.data() + lo);
+        });
+    }
+};
+
+typedef sorted_trace SORTED;
+
+#endif //SORTED_H
@@ -2,27 +2,43 @@
 #define TABLE_H
 
 #include <map>
+#include <span>
 
 #include "counter.h"
+#include "series.h"
 
 using namespace std;
 
-class abstract_table {
-public:
+// packets a batch prefetches ahead of the one being counted
+constexpr static const size_t PREFETCH_AHEAD = 8;
+
+/* table interface, bound at compile time: schemes hold their tables by value */
+template<typename T>
+concept DerivedTable = requires(T& t, const T& ct, const five_tuple& f, flow_digest d, TIME time, DATA c,
+                                span<const packet> batch) {
     // reset all related data structures; act as an empty table afterward
-    virtual void reset() = 0;
-    // return true if inserted successfully
-    virtual bool count(const five_tuple& f, TIME t, DATA c) = 0;
+    t.reset();
+    // return true if inserted successfully; d is f.digest()
+    { t.count(f, d, time, c) } -> same_as<bool>;
+    // pull the counters a packet of digest d would update into cache
+    ct.prefetch(d);
+    // count every packet of batch in order
+    t.count_batch(batch);
     // finish recording and deal with remaining buffered data
-    virtual void flush() = 0;
-    // rebuild counters of five-tuple f in all possible time-window
-    virtual STREAM_QUEUE rebuild(const five_tuple& f, TIME start, TIME last) const = 0;
+    t.flush();
+    // rebuild counters of five-tuple f in [start, last], inclusive
+    { ct.rebuild(f, time, time) } -> same_as<STREAM_QUEUE>;
     // serialize all the non-empty counters in table
-    virtual size_t serialize() const = 0;
+    { ct.serialize() } -> same_as<size_t>;
 };
 
-template<DerivedCounter C = abstract_counter, int W = FULL_WIDTH, int H = FULL_HEIGHT>
-class basic_table : public abstract_table {
+// D derives from basic_table and may hide derived_reset, derived_encode, derived_decode, save_counter, select_val, count, prefetch and
+// count_batch; calls go through D, so they bind and inline statically. D befriends table_base if its
+// replacements are not public
+template<typename D, typename P, DerivedCounter C, int W = P::FULL_WIDTH, int H = FULL_HEIGHT>
+class basic_table {
+public:
+    typedef basic_table table_base;
 protected:
     constexpr static const HASH seeds[] = {0x5A5A5A5A, 0x42424242, 0xDEADBEEF, 0x12345678};
     constexpr static const int WIDTH = W;
@@ -30,19 +46,43 @@ protected:
     static_assert(sizeof(seeds) / sizeof(HASH) >= HEIGHT);
     static_assert(HEIGHT > 0);
 
+    // backing store of a row: sealed counters, their history arrays and rebuild caches; declared before what
+    // lives in it, so it is destroyed after
+    arena storage[HEIGHT]{};
+    // nodes of the containers inside the live counters of a row
+    pool nodes[HEIGHT]{};
     C counters[HEIGHT][WIDTH]{};
-    deque<C> history[HEIGHT][WIDTH]{};
+    arena_array<sealed_t<C>> history[HEIGHT][WIDTH]{};
+    // start times of history, ascending: a bucket's counters never overlap in time
+    arena_array<TIME> starts[HEIGHT][WIDTH]{};
+
+    D& self() { return static_cast<D&>(*this); }
+    const D& self() const { return static_cast<const D&>(*this); }
 
-    virtual void derived_reset() { }
-    virtual void save_counter(HASH row, HASH col) {
-        history[row][col].push_back(counters[row][col]);
+    void derived_reset() { }
+    // the state of D beyond the history, after it in the binary form
+    void derived_encode(codec::writer&) const { }
+    void derived_decode(codec::reader&) { }
+    // append counters[row][col] to its history, sealed if C supports it
+    void archive(HASH row, HASH col) {
+        starts[row][col].push_back(storage[row], counters[row][col].start());
+        if constexpr(same_as<sealed_t<C>, C>)
+            history[row][col].push_back(storage[row], counters[row][col]);
+        else
+            history[row][col].push_back(storage[row], counters[row][col].seal(storage[row]));
+    }
+    void save_counter(HASH row, HASH col) {
+        archive(row, col);
         counters[row][col].reset();
     }
-    static auto first_history(const deque<C>& qc, TIME start) {
-        return upper_bound(qc.begin(), qc.end(), start,
-                             [](const TIME t, const C& c) { return c.start() + MAX_LENGTH > t; });
+    // the historic counters of a bucket that may hold a time in [start, last], by binary search of starts
+    span<const sealed_t<C>> overlapping(HASH row, HASH col, TIME start, TIME last) const {
+        auto& s = starts[row][col];
+        auto lo = partition_point(s.begin(), s.end(), [=](TIME t) { return t + P::MAX_LENGTH <= start; });
+        auto hi = upper_bound(lo, s.end(), last);
+        return {history[row][col].begin() + (lo - s.begin()), history[row][col].begin() + (hi - s.begin())};
     }
-    virtual DATA select_median(array<DATA, HEIGHT>& vals) const {
+    DATA select_median(array<DATA, HEIGHT>& vals) const {
         int size = vals.size();
         sort(vals.begin(), vals.end());
         DATA median = 0;
@@ -56,7 +96,7 @@ protected:
 
         return median;
     }
-    virtual DATA select_min(array<DATA, HEIGHT>& vals) const {
+    DATA select_min(array<DATA, HEIGHT>& vals) const {
         DATA min = *min_element(vals.begin(), vals.end());
         assert(min >= 0);
         if(min < 0)
@@ -65,77 +105,196 @@ protected:
         return min;
     }
 
-    virtual DATA select_val(array<DATA, HEIGHT>& vals) const {
+    DATA select_val(array<DATA, HEIGHT>& vals) const {
         return select_min(vals);
     }
+
+    void update(int row, HASH rem, HASH quo, TIME t, DATA c) {
+        bool result = counters[row][rem].count(t, quo, c);
+        if(result) {
+            self().save_counter(row, rem);
+            counters[row][rem].count(t, quo, c);
+        }
+    }
+    // counters that depend on the run's options read them here, once, instead of on every update
+    static void configure() {
+        if constexpr(requires { C::configure(settings); })
+            C::configure(settings);
+    }
 public:
+    basic_table() {
+        configure();
+        if constexpr(requires(C& c, pool& p) { c.bind(p); })
+            for(int row = 0; row < HEIGHT; row++)
+                for(auto& c : counters[row])
+                    c.bind(nodes[row]);
+    }
+
     // reset all related data structures; act as an empty table afterward
-    virtual void reset() override {
-        derived_reset();
+    // history is dropped wholesale: nothing in it is freed one by one
+    void reset() {
+        configure();
+        self().derived_reset();
         for(auto& row : counters)
             for(auto& c : row)
                 c.reset();
         for(auto& row : history)
             for(auto& c : row)
                 c.clear();
+        for(auto& row : starts)
+            for(auto& s : row)
+                s.clear();
+        for(auto& a : storage)
+            a.reset();
+        for(auto& p : nodes)
+            p.reset();
     }
     // return true if inserted successfully
-    virtual bool count(const five_tuple& f, TIME t, DATA c) override {
+    bool count(const five_tuple&, flow_digest d, TIME t, DATA c) {
         for(int row = 0; row < HEIGHT; row++) {
-            HASH h = f.hash(seeds[row]);
-            HASH rem = h % WIDTH;
-            HASH quo = h / WIDTH;
-            bool result = counters[row][rem].count(t, quo, c);
-            if(result) {
-                save_counter(row, rem);
-                counters[row][rem].count(t, quo, c);
-            }
+            HASH h = d.hash(seeds[row]);
+            update(row, h % WIDTH, h / WIDTH, t, c);
         }
         return true;
     }
+    void prefetch(flow_digest d) const {
+        for(int row = 0; row < HEIGHT; row++)
+            __builtin_prefetch(&counters[row][d.hash(seeds[row]) % WIDTH], 1);
+    }
+    // hash a window of packets and prefetch their counters first, then update in packet order;
+    // tables replacing count or prefetch count one packet at a time instead
+    void count_batch(span<const packet> batch) {
+        if constexpr(!same_as<decltype(&D::count), decltype(&basic_table::count)> ||
+                     !same_as<decltype(&D::prefetch), decltype(&basic_table::prefetch)>) {
+            for(size_t i = 0; i < batch.size(); i++) {
+                if(i + PREFETCH_AHEAD < batch.size())
+                    self().prefetch(batch[i + PREFETCH_AHEAD].digest);
+                self().count(batch[i].flow, batch[i].digest, batch[i].time, batch[i].data);
+            }
+            return;
+        }
+        constexpr static const size_t WINDOW = 16;
+        HASH rem[WINDOW][HEIGHT], quo[WINDOW][HEIGHT];
+        for(size_t lo = 0; lo < batch.size(); lo += WINDOW) {
+            size_t n = min(WINDOW, batch.size() - lo);
+            for(size_t i = 0; i < n; i++)
+                for(int row = 0; row < HEIGHT; row++) {
+                    HASH h = batch[lo + i].digest.hash(seeds[row]);
+                    rem[i][row] = h % WIDTH;
+                    quo[i][row] = h / WIDTH;
+                    __builtin_prefetch(&counters[row][rem[i][row]], 1);
+                }
+            for(size_t i = 0; i < n; i++)
+                for(int row = 0; row < HEIGHT; row++)
+                    update(row, rem[i][row], quo[i][row], batch[lo + i].time, batch[lo + i].data);
+        }
+    }
+    // rows count_row may update from as many threads, 0 unless rows are independent: D keeps count and
+    // save_counter, and the counters keep no shared state
+    constexpr static int row_shards() {
+        if constexpr(same_as<decltype(&D::count), decltype(&basic_table::count)> &&
+                     same_as<decltype(&D::save_counter), decltype(&basic_table::save_counter)>)
+            return row_local<C>() ? HEIGHT : 0;
+        else
+            return 0;
+    }
+    // count every packet of batch in row only; count_row of each row in turn equals count_batch
+    void count_row(int row, span<const packet> batch) {
+        static_assert(row_shards() > 0);
+        for(size_t i = 0; i < batch.size(); i++) {
+            if(i + PREFETCH_AHEAD < batch.size())
+                __builtin_prefetch(&counters[row][batch[i + PREFETCH_AHEAD].digest.hash(seeds[row]) % WIDTH], 1);
+            HASH h = batch[i].digest.hash(seeds[row]);
+            update(row, h % WIDTH, h / WIDTH, batch[i].time, batch[i].data);
+        }
+    }
     // finish recording and deal with remaining buffered data
-    virtual void flush() override {
+    void flush() {
         for(int row = 0; row < HEIGHT; row++) {
             for(int col = 0; col < WIDTH; col++) {
                 if(counters[row][col].empty())
                     continue;
                 counters[row][col].flush();
-                save_counter(row, col);
+                self().save_counter(row, col);
             }
         }
     }
     // rebuild counters of five-tuple f in [start, last], inclusive
-    virtual STREAM_QUEUE rebuild(const five_tuple& f, TIME start, TIME last) const override {
-        vector<array<DATA, HEIGHT>> merger(last - start + 1);
-        for(auto& a : merger)
-            a.fill(0);
-        STREAM_QUEUE result(last - start + 1);
+    STREAM_QUEUE rebuild(const five_tuple& f, TIME start, TIME last) const {
+        // every row's value per tick; kept per thread, so a rebuild allocates only when its range outgrows it
+        thread_local vector<array<DATA, HEIGHT>> merger;
+        merger.assign(last - start + 1, array<DATA, HEIGHT>{});
+        STREAM_QUEUE result(start, last - start + 1);
 
+        flow_digest d = f.digest();
         for(int row = 0; row < HEIGHT; row++) {
-            HASH h = f.hash(seeds[row]);
+            HASH h = d.hash(seeds[row]);
             HASH rem = h % WIDTH;
             HASH quo = h / WIDTH;
 
-            auto& hc = history[row][rem];
-            for(auto c = first_history(hc, start); c != hc.end(); c++) {
-                if(c->start() > last)
-                    break;
-                for(auto& p : c->rebuild(quo))
-                    if(p.first >= start && p.first <= last) [[likely]] {
+            for(auto& c : overlapping(row, rem, start, last)) {
+                // counters that can rebuild part of their span only yield times in [start, last]
+                if constexpr(requires { c.rebuild_range(quo, start, last); }) {
+                    for(auto p : c.rebuild_range(quo, start, last))
                         merger[p.first - start][row] = p.second;
-                    }
+                } else {
+                    for(auto p : c.rebuild(quo))
+                        if(p.first >= start && p.first <= last) [[likely]] {
+                            merger[p.first - start][row] = p.second;
+                        }
+                }
             }
         }
 
-        for(int pos = 0; pos <= last - start; pos++) {
-            result[pos].first = pos + start;
-            result[pos].second = select_val(merger[pos]);
-        }
+        for(size_t pos = 0; pos < result.size(); pos++)
+            result.value(pos) = self().select_val(merger[pos]);
 
         return result;
     }
+    /* the history in binary form, live counters left out: flush first
+     *   HEIGHT, WIDTH, then per bucket its count of counters and, for each, its start as the difference from the
+     *   one before and its own encode; then derived_encode */
+    void encode(codec::writer& out) const requires EncodableCounter<sealed_t<C>> {
+        out.varint(HEIGHT);
+        out.varint(WIDTH);
+        for(int row = 0; row < HEIGHT; row++)
+            for(int col = 0; col < WIDTH; col++) {
+                out.varint(history[row][col].size());
+                TIME last = 0;
+                for(size_t i = 0; i < history[row][col].size(); i++) {
+                    out.varint(starts[row][col][i] - last);
+                    last = starts[row][col][i];
+                    history[row][col][i].encode(out);
+                }
+            }
+        self().derived_encode(out);
+    }
+    // replace the table by one encode wrote, which then rebuilds as the encoded table did; false, with the table
+    // reset and in failed, on anything else
+    bool decode(codec::reader& in) requires EncodableCounter<sealed_t<C>> {
+        reset();
+        if(in.varint() != HEIGHT || in.varint() != WIDTH)
+            in.fail();
+        for(int row = 0; row < HEIGHT && !in.failed(); row++)
+            for(int col = 0; col < WIDTH && !in.failed(); col++) {
+                // every counter takes a byte at least
+                const size_t n = in.bounded(in.remaining());
+                TIME last = 0;
+                for(size_t i = 0; i < n && !in.failed(); i++) {
+                    // starts only rise, so a delta past the end of TIME would unsort them
+                    last += in.bounded(numeric_limits<TIME>::max() - last);
+                    starts[row][col].push_back(storage[row], last);
+                    history[row][col].push_back(storage[row], sealed_t<C>::decode(in, storage[row], last));
+                }
+            }
+        if(!in.failed())
+            self().derived_decode(in);
+        if(in.failed())
+            reset();
+        return !in.failed();
+    }
     // serialize all the historic counters
-    virtual size_t serialize() const override {
+    size_t serialize() const {
         size_t result = 0;
         for(int row = 0; row < HEIGHT; row++)
             for(int col = 0; col < WIDTH; col++) {
@@ -148,8 +307,5 @@ public:
     }
 };
 
-template<typename T>
-concept DerivedTable = std::is_base_of_v<abstract_table, T>;
-
 
 #endif //TABLE_H
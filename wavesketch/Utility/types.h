@@ -3,11 +3,9 @@
 
 #include <cstdint>
 #include <utility>
-#include <unordered_map>
-#include <unordered_set>
-#include <deque>
 
 #include "five_tuple.h"
+#include "flow_map.h"
 
 using namespace std;
 
@@ -16,9 +14,15 @@ typedef uint32_t TIME;
 typedef size_t HASH;
 typedef uint8_t BYTE;
 
-typedef unordered_set<five_tuple> LABELS;
-typedef deque<pair<TIME, DATA>> STREAM_QUEUE;
-typedef unordered_map<five_tuple, STREAM_QUEUE> STREAM;
-typedef deque<tuple<five_tuple, TIME, DATA>> SORTED;
+/* one packet with its flow digest, the unit of batched counting */
+struct packet {
+    five_tuple flow;
+    flow_digest digest;
+    TIME time;
+    DATA data;
+};
+
+typedef flow_set LABELS;
+typedef pair<TIME, DATA> SAMPLE;
 
 #endif //TYPES_H
@@ -9,23 +9,22 @@ using namespace std;
 
 namespace Wavelet {
 
-    typedef STREAM_QUEUE::const_iterator SQptr;
     typedef uint16_t DATA16;
 
-    template<bool BY_THRESHOLD = false>
+    template<bool BY_THRESHOLD = false, typename P = default_parameter>
     class counter : public abstract_counter {
+    public:
+        typedef Wavelet::record<P> record;
+        constexpr static const int T_DEPTH = ROUND(P::FULL_DEPTH * 4 + 4 - 44, 4) / 2; // threshold
+        constexpr static const int DEPTH = ROUND(P::FULL_DEPTH * 4 + 4 - 42, 4); // priority
+        // pseudo_heap evicts through its static generator
+        constexpr static const bool STATIC_RANDOM = BY_THRESHOLD;
     protected:
-#ifdef BY_BYTES
-        constexpr static const int SCALE = 1000;
-#else
-        constexpr static const int SCALE = 1;
-#endif
-        constexpr static const int T_DEPTH = ROUND(FULL_DEPTH * 4 + 4 - 44, 4) / 2; // threshold
-        constexpr static const int DEPTH = ROUND(FULL_DEPTH * 4 + 4 - 42, 4); // priority
-
-        // # of data read
+        constexpr static const int LEVEL = P::LEVEL;
+
+        // # of data read, up to MAX_LENGTH: wider than TIME_DIFF, which would wrap halfway there
         TIME start_time{};
-        TIME_DIFF elapse{};
+        uint32_t elapse{};
         DATA16 value{};
 
         array<DATA16, LEVEL> last_coef{};
@@ -34,13 +33,18 @@ namespace Wavelet {
         heap<record, DEPTH> detail{};
         pseudo_heap<record, T_DEPTH> th_detail[2]{};
 
-        mutable STREAM_QUEUE cache{};
+        // units of DATA per stored unit, resolved by configure rather than per coefficient
+        inline static DATA unit = 1;
 
+        static DATA scale() {
+            return unit;
+        }
         static DATA truncate(DATA d) {
-            return d / SCALE + (SCALE > 1 && d % SCALE >= SCALE / 2);
+            const DATA s = scale();
+            return d / s + (s > 1 && d % s >= s / 2);
         }
         static DATA recover(DATA t) {
-            return t * SCALE;
+            return t * scale();
         }
         static DATA16 adds(DATA16 a, DATA16 b) {
             DATA16 r = a + b;
@@ -68,17 +72,22 @@ namespace Wavelet {
             heap_insert(level, hi);
             return lo;
         }
-        static void inverse_transform(DATA& lo, DATA& hi) {
-            DATA l = (lo + hi) / 2;
-            DATA h = (lo - hi) / 2;
-            lo = l;
-            hi = h;
-        }
     public:
-        uint16_t get_count() const {
+        // restart the generator the threshold heaps evict through, so a reset scheme draws as a fresh one does
+        static void reseed() {
+            if constexpr(BY_THRESHOLD)
+                pseudo_heap<record, T_DEPTH>::reseed();
+        }
+        // resolve the storage unit from the run's options; tables call it when built and reset
+        static void configure(const options& o) {
+            const DATA u = o.by_bytes ? 1000 : 1;
+            if(unit != u)
+                unit = u;
+        }
+        uint32_t get_count() const {
             return elapse;
         }
-        void reset() override {
+        void reset() {
             start_time = 0;
             elapse = 0;
             value = 0;
@@ -89,15 +98,13 @@ namespace Wavelet {
                 th_detail[1].reset();
             } else
                 detail.reset();
-
-            cache.clear();
         }
 
-        bool count(TIME t, HASH, DATA c) override {
+        bool count(TIME t, HASH, DATA c) {
             assert(t >= start_time);
             if(start_time == 0) [[unlikely]] {
                 start_time = t;
-            } else if(t - start_time >= MAX_LENGTH) [[unlikely]] {
+            } else if(t - start_time >= P::MAX_LENGTH) [[unlikely]] {
                 flush();
                 return true;
             } else if(t > start_time + elapse) [[unlikely]] {
@@ -111,11 +118,11 @@ namespace Wavelet {
             return false;
         }
 
-        void flush() override {
+        void flush() {
             if(empty())
                 return;
 
-            int level = countr_one(elapse & INDEX_MASK);
+            int level = countr_one(elapse & P::INDEX_MASK);
             DATA last_val = truncate(value);
             for(int l = 0; l < level; l++)
                 last_val = transform_pair(l, last_val);
@@ -133,7 +140,7 @@ namespace Wavelet {
             if(empty())
                 return;
 
-            TIME_DIFF new_elapse = t - start_time;
+            uint32_t new_elapse = t - start_time;
             int level = 31 - countl_zero((uint32_t)(elapse ^ new_elapse));
             if(level >= LEVEL)
                 level = LEVEL;
@@ -163,121 +170,254 @@ namespace Wavelet {
             value = 0;
         }
 
-        STREAM_QUEUE rebuild(HASH) const override {
-            // parameter has no use here
-            assert(!empty());
-            if(!cache.empty())
-                return cache;
+        bool empty() const {
+            return start_time == 0;
+        }
 
-            cache.resize(elapse);
+        TIME start() const {
+            return start_time;
+        }
 
-            vector<DATA> temp(elapse, 0);
-            // copy heap data
+        size_t serialize() const {
+            size_t result = 0;
+            result += sizeof(start_time);
+            result += sizeof(elapse);
+            result += sizeof(DATA16) * popcount(elapse & P::INDEX_MASK);
+            result += sizeof(DATA16) * min<uint32_t>(RESERVED, elapse >> LEVEL);
             if(BY_THRESHOLD) {
-                for(auto& d : th_detail)
-                    for(int i = 0; i < d.size_hi; i++) {
-                        int pos = d.heap_data[i].pos;
-                        temp[pos] = recover(d.heap_data[i].data());
-                    }
-                for(auto& d : th_detail)
-                    for(int i = T_DEPTH - 1; i > d.size_lo; i--) {
-                        int pos = d.heap_data[i].pos;
-                        temp[pos] = recover(d.heap_data[i].data());
-                    }
+                result += th_detail[0].serialize();
+                result += th_detail[1].serialize();
+            } else
+                result += detail.serialize();
+            return result;
+        }
+
+        /* finished counter as kept in history: only the coefficients and records in use, stored in a row arena as
+         *   header | last_coef of the set bits of elapse | top_level | records
+         * the rebuild cache comes from the same arena on first use */
+        class sealed {
+            struct header {
+                TIME start_time;
+                uint32_t elapse;
+                uint16_t size;
+            };
+
+            const header* head;
+            arena* home;
+            // rebuilt values less whatever subtract took away
+            mutable SAMPLE* cache = nullptr;
+            // work of the rebuild_range calls that skipped the cache so far
+            mutable uint32_t spent = 0;
+
+            int coef_count() const {
+                return popcount(head->elapse & P::INDEX_MASK);
             }
-            else
-                for(int i = 0; i < detail.size; i++) {
-                    int pos = detail.heap_data[i].pos;
-                    temp[pos] = recover(detail.heap_data[i].data());
+            int top_count() const {
+                return min<uint32_t>(RESERVED, head->elapse >> LEVEL);
+            }
+            const DATA16* coefs() const {
+                return reinterpret_cast<const DATA16*>(head + 1);
+            }
+            const record* records() const {
+                return reinterpret_cast<const record*>(coefs() + coef_count() + top_count());
+            }
+            sealed(const header* h, arena& a) : head(h), home(&a) {}
+        public:
+            sealed(const counter& c, arena& a) : home(&a) {
+                size_t size = c.detail.size;
+                if(BY_THRESHOLD) {
+                    size = 0;
+                    for(auto& d : c.th_detail)
+                        size += d.size_hi + (T_DEPTH - 1 - d.size_lo);
                 }
+                int coefs = popcount(c.elapse & P::INDEX_MASK);
+                int tops = min<uint32_t>(RESERVED, c.elapse >> LEVEL);
+                auto h = a.allocate<header>(sizeof(header) + sizeof(DATA16) * (coefs + tops) + sizeof(record) * size);
+                *h = {c.start_time, c.elapse, (uint16_t)size};
+
+                auto v = reinterpret_cast<DATA16*>(h + 1);
+                for(int i = 0; i < LEVEL; i++)
+                    if((c.elapse >> i) & 1)
+                        *v++ = c.last_coef[i];
+                v = copy_n(c.top_level.begin(), tops, v);
+
+                auto r = reinterpret_cast<record*>(v);
+                if(BY_THRESHOLD) {
+                    for(auto& d : c.th_detail)
+                        r = copy_n(d.heap_data, d.size_hi, r);
+                    for(auto& d : c.th_detail)
+                        for(int i = T_DEPTH - 1; i > d.size_lo; i--)
+                            *r++ = d.heap_data[i];
+                } else
+                    copy_n(c.detail.heap_data, c.detail.size, r);
+                head = h;
+            }
 
-            // copy top level
-            for(int i = 0; i < elapse >> LEVEL; i++)
-                temp[i << LEVEL] = recover(top_level[i]);
-
-            // copy data yet to be transformed
-            bitset<16> mask{elapse};
-            for(int i = 0; i < LEVEL; i++)
-                if(mask[i])
-                    temp[(elapse >> (i + 1)) << (i + 1)] = recover(last_coef[i]);
-
-            // inverse-transform each section except for the last one
-            uint16_t last_section = (elapse >> LEVEL) << LEVEL;
-            for(uint32_t frag = 0; frag < last_section; frag += 1 << LEVEL) {
-                for(uint32_t p = 1 << LEVEL; p > 0; p--) {
-                    uint32_t pos = frag + p;
-                    for(int i = countr_zero(p) - 1; i >= 0; i--) {
-                        inverse_transform(temp[pos - (2 << i)], temp[pos - (1 << i)]);
-                    }
+            span<SAMPLE> rebuild(HASH) const {
+                // parameter has no use here
+                return {cache_once(cache, *home, head->elapse, [this](SAMPLE* out) { build(out); }), head->elapse};
+            }
+            // the values of rebuild at times [first, last]: only the coefficients above the range, into a buffer of
+            // the calling thread that lives until its next rebuild_range, while such calls cost less in total than
+            // the cache; a slice of the cache otherwise
+            span<const SAMPLE> rebuild_range(HASH h, TIME first, TIME last) const {
+                const uint32_t elapse = head->elapse;
+                const size_t lo = max(first, head->start_time) - head->start_time;
+                const size_t hi = min<size_t>(last - head->start_time, elapse - 1);
+                if(elapse == 0 || last < head->start_time || lo > hi)
+                    return {};
+                const size_t cost = coef_count() + top_count() + head->size + hi - lo + 1;
+                if(atomic_ref<SAMPLE*>(cache).load(memory_order_acquire) != nullptr || !rent_part(spent, cost, elapse))
+                    return rebuild(h).subspan(lo, hi - lo + 1);
+
+                thread_local vector<haar::coefficient> coef;
+                thread_local vector<DATA> temp;
+                thread_local vector<SAMPLE> result;
+                coef.clear();
+                each_coefficient([](uint32_t pos, DATA d) { coef.push_back({pos, d}); });
+                temp.resize(hi - lo + 1);
+                haar::inverse_range(coef, elapse, LEVEL, lo, hi, temp.data());
+
+                result.resize(temp.size());
+                for(size_t i = 0; i < temp.size(); i++)
+                    result[i] = {TIME(head->start_time + lo + i), temp[i] > 0 ? temp[i] : scale()};
+                return result;
+            }
+        private:
+            // call f(pos, coefficient) in transform order; a later one replaces an earlier one at the same pos
+            template<typename F>
+            void each_coefficient(F&& f) const {
+                const uint32_t elapse = head->elapse;
+
+                // heap data
+                auto r = records();
+                for(int i = 0; i < head->size; i++)
+                    f(r[i].pos, recover(r[i].data()));
+
+                // top level
+                const DATA16* v = coefs() + coef_count();
+                for(int i = 0; i < elapse >> LEVEL; i++)
+                    f(i << LEVEL, recover(v[i]));
+
+                // data yet to be transformed
+                v = coefs();
+                bitset<16> mask{elapse};
+                for(int i = 0; i < LEVEL; i++)
+                    if(mask[i])
+                        f((elapse >> (i + 1)) << (i + 1), recover(*v++));
+            }
+            void build(SAMPLE* out) const {
+                const uint32_t elapse = head->elapse;
+                // coefficients in transform order, then the values in place
+                thread_local vector<DATA> coef;
+                coef.assign(elapse, 0);
+                each_coefficient([](uint32_t pos, DATA d) { coef[pos] = d; });
+                haar::inverse(coef.data(), elapse, LEVEL);
+
+                // stamp the values with their times
+                for(int pos = 0; pos < elapse; pos++) {
+                    out[pos].first = head->start_time + pos;
+                    out[pos].second = coef[pos] > 0 ? coef[pos] : scale();
                 }
             }
 
-            // inverse-transform the last section
-            for(uint32_t pos = elapse; pos > last_section; pos--)
-                for(int i = countr_zero(pos) - 1; i >= 0; i--)
-                    inverse_transform(temp[pos - (2 << i)], temp[pos - (1 << i)]);
+        public:
+            // given a precisely-recorded flow q, subtract its values from index i on from every recorded
+            // time-window; return the index of the first value past this counter
+            size_t subtract(HASH h, const STREAM_QUEUE& q, size_t i) const {
+                auto values = rebuild(h);
+
+                auto cache_it = upper_bound(values.begin(), values.end(), q.time(i),
+                                            [](const TIME& t, const auto& p) { return t <= p.first; });
+                while(i < q.size() && cache_it != values.end()) {
+                    if(q.time(i) > cache_it->first)
+                        cache_it++;
+                    else if(q.time(i) < cache_it->first)
+                        i++;
+                    else [[likely]] {
+                        cache_it->second -= q.value(i);
+                        i++;
+                        cache_it++;
+                    }
+                }
 
-            // copy from temp to result
-            for(int pos = 0; pos < elapse; pos++) {
-                cache[pos].first = start_time + pos;
-                cache[pos].second = temp[pos] > 0 ? temp[pos] : SCALE;
+                return i;
             }
 
-            return cache;
-        }
-
-        // given a precisely-recorded flow, subtract its value from every recorded time-window
-        SQptr subtract(HASH h, SQptr it, const SQptr& end) const {
-            assert(!empty());
-            if(cache.empty()) [[unlikely]] {
-                rebuild(h);
+            // for every time of times, add the sum of the values before it to out, straight from the
+            // coefficients: times before the counter add nothing, times past it all of it. these are the sums the
+            // transform kept, before rebuild lifts the values at or below zero
+            void add_prefix(span<const TIME> times, DATA* out) const {
+                thread_local vector<haar::coefficient> coef;
+                thread_local vector<size_t> xs;
+                thread_local vector<DATA> sums;
+                coef.clear();
+                each_coefficient([](uint32_t pos, DATA d) { coef.push_back({pos, d}); });
+                xs.resize(times.size());
+                for(size_t i = 0; i < times.size(); i++)
+                    xs[i] = clamp<int64_t>((int64_t)times[i] - head->start_time, 0, head->elapse);
+                sums.resize(times.size());
+                haar::prefix_sums(coef, head->elapse, LEVEL, xs, sums.data());
+                for(size_t i = 0; i < times.size(); i++)
+                    out[i] += sums[i];
             }
 
-            auto cache_it = upper_bound(cache.begin(), cache.end(), it->first,
-                                        [](const TIME& t, const auto& p) { return t <= p.first; });
-            while(it != end && cache_it != cache.end()) {
-                if(it->first > cache_it->first)
-                    cache_it++;
-                else if(it->first < cache_it->first)
-                    it++;
-                else [[likely]] {
-                    cache_it->second -= it->second;
-                    it++;
-                    cache_it++;
-                }
+            TIME start() const {
+                return head->start_time;
+            }
+            // timestamp of the last value, inclusive
+            TIME last() const {
+                return head->start_time + head->elapse - 1;
             }
 
-            return it;
-        }
-
-        bool empty() const override {
-            return start_time == 0;
-        }
+            // same count as counter::serialize before sealing
+            size_t serialize() const {
+                size_t result = 0;
+                result += sizeof(head->start_time);
+                result += sizeof(head->elapse);
+                result += sizeof(DATA16) * (coef_count() + top_count());
+                // one size field per heap
+                result += sizeof(uint16_t) * (BY_THRESHOLD ? 2 : 1);
+                for(int i = 0; i < head->size; i++)
+                    result += records()[i].serialize();
+                return result;
+            }
 
-        TIME start() const override {
-            return start_time;
-        }
+            // elapse, the record count, the coefficients zigzag-coded, then the records packed in heap order, which
+            // list_min reads
+            void encode(codec::writer& out) const {
+                out.varint(head->elapse);
+                out.varint(head->size);
+                for(int i = 0; i < coef_count() + top_count(); i++)
+                    out.zigzag(int16_t(coefs()[i]));
+                record::pack(out, {records(), head->size});
+            }
+            static sealed decode(codec::reader& in, arena& a, TIME start) {
+                const uint32_t elapse = in.bounded(P::MAX_LENGTH);
+                const uint16_t size = in.bounded(BY_THRESHOLD ? 2 * T_DEPTH : DEPTH);
+                const int coefs = popcount(elapse & P::INDEX_MASK);
+                const int tops = min<uint32_t>(RESERVED, elapse >> LEVEL);
+                auto h = a.allocate<header>(sizeof(header) + sizeof(DATA16) * (coefs + tops) + sizeof(record) * size);
+                *h = {start, elapse, size};
+
+                auto v = reinterpret_cast<DATA16*>(h + 1);
+                for(int i = 0; i < coefs + tops; i++)
+                    v[i] = in.within(numeric_limits<int16_t>::min(), numeric_limits<int16_t>::max());
+                record::unpack(in, reinterpret_cast<record*>(v + coefs + tops), size, elapse);
+                return sealed(h, a);
+            }
 
-        size_t serialize() const override {
-            size_t result = 0;
-            result += sizeof(start_time);
-            result += sizeof(elapse);
-            result += sizeof(DATA16) * popcount(elapse & INDEX_MASK);
-            result += sizeof(DATA16) * min<uint32_t>(RESERVED, elapse >> LEVEL);
-            if(BY_THRESHOLD) {
-                result += th_detail[0].serialize();
-                result += th_detail[1].serialize();
-            } else
-                result += detail.serialize();
-            return result;
-        }
+            record list_min() const {
+                return records()[0];
+            }
 
-        record list_min() const {
-            return detail.heap_data[0];
-        }
+            bool heap_full() const {
+                return !BY_THRESHOLD && head->size == DEPTH;
+            }
+        };
 
-        bool heap_full() const {
-            return detail.size == DEPTH;
+        sealed seal(arena& a) const {
+            return sealed(*this, a);
         }
     };
 
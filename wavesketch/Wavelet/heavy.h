@@ -8,44 +8,81 @@ using namespace std;
 
 namespace Wavelet {
 
-    template<bool BY_THRESHOLD = false>
-    class heavy : public basic_table<counter<BY_THRESHOLD>, HALF_WIDTH, PAIR_HEIGHT> {
+    template<bool BY_THRESHOLD = false, typename P = default_parameter>
+    class heavy : public basic_table<heavy<BY_THRESHOLD, P>, P, counter<BY_THRESHOLD, P>, P::HALF_WIDTH, PAIR_HEIGHT> {
+        friend typename heavy::table_base;
+    public:
+        typedef Wavelet::record<P> record;
     protected:
         constexpr static const HASH seed = heavy::seeds[heavy::HEIGHT];
         static_assert(sizeof(heavy::seeds) / sizeof(HASH) >= heavy::HEIGHT + 1);
 
         uint32_t frequency[heavy::HEIGHT][heavy::WIDTH]{};
         five_tuple label[heavy::HEIGHT][heavy::WIDTH]{};
-        deque<five_tuple> history_label[heavy::HEIGHT][heavy::WIDTH]{};
+        // stored in the row arenas next to the history they label
+        arena_array<five_tuple> history_label[heavy::HEIGHT][heavy::WIDTH]{};
 
-        void derived_reset() override {
+        void derived_reset() {
             memset(frequency, 0, sizeof(frequency));
             memset(label, 0, sizeof(label));
             for(auto& row : history_label)
                 for(auto& c : row)
                     c.clear();
         }
-        void save_counter(HASH row, HASH col) override {
+        // the labels of the history, per bucket in its order: 0 for the label before again, else 1 and its fields
+        void derived_encode(codec::writer& out) const {
+            for(auto& row : history_label)
+                for(auto& hl : row) {
+                    five_tuple last{};
+                    for(auto& l : hl) {
+                        out.varint(l != last);
+                        if(l != last) {
+                            out.varint(l.src_ip);
+                            out.varint(l.dst_ip);
+                            out.varint(l.src_port);
+                            out.varint(l.dst_port);
+                            out.varint(l.protocol);
+                        }
+                        last = l;
+                    }
+                }
+        }
+        void derived_decode(codec::reader& in) {
+            for(int row = 0; row < heavy::HEIGHT; row++)
+                for(int col = 0; col < heavy::WIDTH; col++) {
+                    five_tuple last{};
+                    for(size_t i = 0; i < heavy::history[row][col].size() && !in.failed(); i++) {
+                        if(in.bounded(1)) {
+                            last.src_ip = in.bounded(numeric_limits<uint32_t>::max());
+                            last.dst_ip = in.bounded(numeric_limits<uint32_t>::max());
+                            last.src_port = in.bounded(numeric_limits<uint16_t>::max());
+                            last.dst_port = in.bounded(numeric_limits<uint16_t>::max());
+                            last.protocol = in.bounded(numeric_limits<uint8_t>::max());
+                        }
+                        history_label[row][col].push_back(heavy::storage[row], last);
+                    }
+                }
+        }
+        void save_counter(HASH row, HASH col) {
             auto& c = heavy::counters[row][col];
-            auto& hc = heavy::history[row][col];
             auto& l = label[row][col];
             auto& hl = history_label[row][col];
 
             c.flush();
-            hc.push_back(c);
+            heavy::archive(row, col);
             c.reset();
-            hl.push_back(l);
+            hl.push_back(heavy::storage[row], l);
         }
         void evict(HASH row, HASH col) {
             auto& c = heavy::counters[row][col];
-            if(c.get_count() >= RETAIN_THRESH)
+            if(c.get_count() >= P::RETAIN_THRESH)
                 save_counter(row, col);
             else
                 c.reset();
         }
     public:
-        bool count(const five_tuple& f, TIME t, DATA c) override {
-            HASH h = f.hash(seed);
+        bool count(const five_tuple& f, flow_digest d, TIME t, DATA c) {
+            HASH h = d.hash(seed);
             HASH rem = h % heavy::WIDTH;
             HASH quo = h / heavy::WIDTH;
             HASH row;
@@ -81,35 +118,60 @@ namespace Wavelet {
             }
         }
 
-        STREAM_QUEUE rebuild(const five_tuple& f, TIME, TIME) const override {
-            map<TIME, DATA> merger;
-            // search f in existing labels
+        void prefetch(flow_digest d) const {
+            HASH rem = d.hash(seed) % heavy::WIDTH;
+            for(int row = 0; row < heavy::HEIGHT; row++) {
+                __builtin_prefetch(&label[row][rem]);
+                __builtin_prefetch(&frequency[row][rem], 1);
+                __builtin_prefetch(&heavy::counters[row][rem], 1);
+            }
+        }
+        // g(row, c) for every historic counter c labeled f that may hold a time in [start, last]
+        template<typename F>
+        void each_counter(const five_tuple& f, TIME start, TIME last, F&& g) const {
+            // search f in the labels of the counters found by time
             HASH col = f.hash(seed) % heavy::WIDTH;
-            HASH row;
-            for(row = 0; row < heavy::HEIGHT; row++) {
+            for(HASH row = 0; row < heavy::HEIGHT; row++) {
                 auto& hl = history_label[row][col];
-                for(auto l = hl.begin(); l != hl.end(); l++) {
-                    if(*l == f) {
-                        auto& hc = heavy::history[row][col];
-                        auto c = hc.begin() + (l - hl.begin());
-                        for(auto& p : c->rebuild(row))
-                            merger[p.first] = p.second;
-                    }
-                }
+                const auto first = heavy::history[row][col].begin();
+                for(auto& c : heavy::overlapping(row, col, start, last))
+                    if(hl[&c - first] == f)
+                        g(row, c);
             }
+        }
+        STREAM_QUEUE rebuild(const five_tuple& f, TIME start, TIME last) const {
+            map<TIME, DATA> merger;
+            each_counter(f, start, last, [&](HASH row, auto& c) {
+                for(auto p : c.rebuild(row))
+                    if(p.first >= start && p.first <= last)
+                        merger[p.first] = p.second;
+            });
 
             STREAM_QUEUE result;
             for(auto& p : merger)
-                result.emplace_back(p.first, p.second);
+                result.push_back(p.first, p.second);
 
             return result;
         }
 
+        // for every time of times, ascending, add the sum of f before it to out, from the coefficients of its
+        // counters that may hold one of the times: the earlier ones add the same to every time
+        void add_prefix(const five_tuple& f, span<const TIME> times, DATA* out) const {
+            each_counter(f, times.front(), times.back(), [&](HASH, auto& c) { c.add_prefix(times, out); });
+        }
+        // the times [start, last] of the counters of f that may hold a time in [first, last], in no order
+        vector<pair<TIME, TIME>> spans(const five_tuple& f, TIME first, TIME last) const {
+            vector<pair<TIME, TIME>> result;
+            each_counter(f, first, last, [&](HASH, auto& c) { result.push_back({c.start(), c.last()}); });
+            return result;
+        }
+
         LABELS labels() const {
             LABELS result;
             for(auto& row : history_label)
                 for(auto& c : row)
-                    result.insert(c);
+                    for(auto& l : c)
+                        result.insert(l);
             return result;
         }
 
@@ -28,25 +28,26 @@ namespace Wavelet {
     //     ++++++++++______++++++++_...
     //              ^ => t-= d+1
     //    ^ => t-- for p+1 times
+    template<typename P = default_parameter>
     class interval : public abstract_counter {
+    public:
+        typedef pair<TIME_DIFF, TIME_DIFF> gap;
     protected:
-        constexpr static const int LENGTH = MAX_LENGTH / 2;
+        // as many gaps as MAX_LENGTH holds, while pointer can count them
+        constexpr static const int LENGTH = min<uint32_t>(P::MAX_LENGTH / 2, numeric_limits<uint16_t>::max());
         TIME start_time{};
         TIME last_time{};
         // consecutive time period
         TIME_DIFF period{};
         uint16_t pointer{};
 
-        array<pair<TIME_DIFF, TIME_DIFF>, LENGTH> history{};
-
-        mutable STREAM_QUEUE cache{};
+        array<gap, LENGTH> history{};
     public:
-        void reset() override {
+        void reset() {
             start_time = 0;
             last_time = 0;
             period = 0;
             pointer = 0;
-            cache.clear();
         }
 
         bool same_as_last(TIME t) {
@@ -56,22 +57,26 @@ namespace Wavelet {
             return t == last_time;
         }
 
-        bool count(TIME t, HASH, DATA) override {
+        bool count(TIME t, HASH, DATA) {
             assert(t > last_time);
             if(start_time == 0) [[unlikely]] {
                 start_time = t;
-            } else if(t - start_time >= MAX_LENGTH) [[unlikely]] {
+            } else if(t - start_time >= P::MAX_LENGTH) [[unlikely]] {
                 return true;
             } else {
-                TIME_DIFF delta = t - last_time;
+                // a gap or a run longer than TIME_DIFF holds ends the interval, as a full history does
+                const TIME delta = t - last_time;
                 if(delta != 1) [[unlikely]] {
-                    if(pointer == LENGTH) [[unlikely]] {
+                    if(pointer == LENGTH || delta - 2 > numeric_limits<TIME_DIFF>::max()) [[unlikely]] {
                         return true;
                     }
                     history[pointer] = {period, delta - 2};
                     period = 0;
                     pointer++;
                 } else {
+                    if(period == numeric_limits<TIME_DIFF>::max()) [[unlikely]] {
+                        return true;
+                    }
                     period++;
                 }
             }
@@ -79,44 +84,67 @@ namespace Wavelet {
             return false;
         }
 
-        STREAM_QUEUE rebuild(HASH) const override {
-            if(start_time == 0) [[unlikely]] {
-                return {};
-            } else if(!cache.empty())
-                return cache;
-
+        // number of recorded times of an interval ending in a run of period + 1
+        static size_t times(TIME_DIFF period, span<const gap> gaps) {
+            size_t result = period + 1;
+            for(auto& g : gaps)
+                result += g.first + 1;
+            return result;
+        }
+        // write every recorded time, with zero data, of an interval ending at last into the times() slots before out
+        template<typename I>
+        static void timestamps(TIME last, TIME_DIFF period, span<const gap> gaps, I out) {
             // rebuild in reverse order
-            TIME t = last_time;
+            TIME t = last;
             for(int i = 0; i <= period; i++)
-                cache.emplace_front(t--, 0);
-            for(int pos = pointer - 1; pos >= 0; pos--) {
-                t -= history[pos].second + 1;
-                for(int i = 0; i <= history[pos].first; i++)
-                    cache.emplace_front(t--, 0);
+                *--out = {t--, 0};
+            for(int pos = gaps.size() - 1; pos >= 0; pos--) {
+                t -= gaps[pos].second + 1;
+                for(int i = 0; i <= gaps[pos].first; i++)
+                    *--out = {t--, 0};
             }
+        }
 
-            return cache;
+        // call f(t, n) for every run of n recorded times from t, in order, of an interval starting at start
+        template<typename F>
+        static void runs(TIME start, TIME_DIFF period, span<const gap> gaps, F&& f) {
+            TIME t = start;
+            for(auto& g : gaps) {
+                f(t, g.first + 1);
+                t += g.first + g.second + 2;
+            }
+            f(t, period + 1);
         }
 
-        bool empty() const override {
+        bool empty() const {
             return start_time == 0;
         }
 
-        TIME start() const override {
+        TIME start() const {
             return start_time;
         }
+        TIME last() const {
+            return last_time;
+        }
+        TIME_DIFF last_period() const {
+            return period;
+        }
+        span<const gap> gaps() const {
+            return {history.data(), pointer};
+        }
 
-        size_t serialize() const override {
+        size_t serialize() const {
+            return serialize(pointer);
+        }
+        // serialized size of an interval holding n gaps
+        static size_t serialize(size_t n) {
             size_t result = 0;
             // test if start_time == 0
             result += sizeof(bool);
-            result += sizeof(last_time);
-            result += sizeof(period);
-            result += sizeof(pointer);
-            for(int i = 0; i < pointer; i++) {
-                result += sizeof(history[i].first);
-                result += sizeof(history[i].second);
-            }
+            result += sizeof(TIME);
+            result += sizeof(TIME_DIFF);
+            result += sizeof(uint16_t);
+            result += sizeof(gap) * n;
             return result;
         }
     };
@@ -7,6 +7,7 @@ using namespace std;
 
 namespace Wavelet {
 
+    template<typename P = default_parameter>
     struct record {
         uint16_t pos : 14;
         bool sqrt : 1;
@@ -16,16 +17,16 @@ namespace Wavelet {
         record() : pos(0), sqrt(false), sign(false), normalized(0) {};
         record(uint16_t p, DATA d) {
             pos = p;
-            normalized = abs(d) << ((LEVEL - 1 - level()) / 2);
+            normalized = abs(d) << ((P::LEVEL - 1 - level()) / 2);
             sign = d & 0x8000;
             sqrt = !(level() & 1);
         }
 
         constexpr uint8_t level() const {
-            return countr_zero((pos | (INDEX_MASK + 1)));
+            return countr_zero((pos | (P::INDEX_MASK + 1)));
         }
         constexpr DATA data() const {
-            DATA data = normalized >> ((LEVEL - 1 - level()) / 2);
+            DATA data = normalized >> ((P::LEVEL - 1 - level()) / 2);
             return sign ? -data : data;
         }
         constexpr DATA get_data() const {
@@ -39,14 +40,55 @@ namespace Wavelet {
             return result;
         }
 
-        friend constexpr strong_ordering operator<=>(const record& lhs, const record& rhs);
-    };
+        // records as bit fields: the widths of pos and normalized over all of them, then pos, sqrt, sign and
+        // normalized of each in those widths; nothing for none
+        static void pack(codec::writer& out, span<const record> rs) {
+            if(rs.empty())
+                return;
+            uint16_t pos = 0, norm = 0;
+            for(auto& r : rs) {
+                pos |= r.pos;
+                norm |= r.normalized;
+            }
+            const int pos_width = bit_width(pos), norm_width = bit_width(norm);
+            out.bits(pos_width, 4);
+            out.bits(norm_width, 5);
+            for(auto& r : rs) {
+                out.bits(r.pos, pos_width);
+                out.bits(r.sqrt | r.sign << 1, 2);
+                out.bits(r.normalized, norm_width);
+            }
+            out.align();
+        }
+        // n records of pack into out; in fails on a pos at or past limit
+        static void unpack(codec::reader& in, record* out, size_t n, uint32_t limit) {
+            if(n == 0)
+                return;
+            const int pos_width = in.bits(4), norm_width = in.bits(5);
+            if(pos_width > 14 || norm_width > 16)
+                in.fail();
+            for(size_t i = 0; i < n && !in.failed(); i++) {
+                record r;
+                r.pos = in.bits(pos_width);
+                const uint32_t flags = in.bits(2);
+                r.sqrt = flags & 1;
+                r.sign = flags >> 1;
+                r.normalized = in.bits(norm_width);
+                if(r.pos >= limit)
+                    in.fail();
+                out[i] = r;
+            }
+            in.align();
+        }
 
-    constexpr strong_ordering operator<=>(const record& lhs, const record& rhs) {
-        uint32_t l = lhs.normalized * (NOSQRT + lhs.sqrt * SQRT2B);
-        uint32_t r = rhs.normalized * (NOSQRT + rhs.sqrt * SQRT2B);
-        return l <=> r;
-    }
+        // what records compare by: normalized scaled back by sqrt(2) where it was divided by it
+        constexpr uint32_t key() const {
+            return normalized * (NOSQRT + sqrt * SQRT2B);
+        }
+        friend constexpr strong_ordering operator<=>(const record& lhs, const record& rhs) {
+            return lhs.key() <=> rhs.key();
+        }
+    };
 
 } // Wavelet
 
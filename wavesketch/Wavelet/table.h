@@ -8,30 +8,42 @@ using namespace std;
 
 namespace Wavelet {
 
-    template<bool BY_THRESHOLD = false>
-    class table : public basic_table<counter<BY_THRESHOLD>, FULL_WIDTH, LESS_HEIGHT> {
+    template<bool BY_THRESHOLD = false, typename P = default_parameter>
+    class table : public basic_table<table<BY_THRESHOLD, P>, P, counter<BY_THRESHOLD, P>, P::FULL_WIDTH, LESS_HEIGHT> {
     public:
+        typedef Wavelet::record<P> record;
+
         // for every flow from heavy-hitter table, subtract its value from the corresponding counter
         void subtract(const STREAM& dict) const {
             for(auto& p : dict) {
+                flow_digest d = p.first.digest();
                 for(int row = 0; row < table::HEIGHT; row++) {
-                    auto& f = p.first;
-                    auto q_begin = p.second.begin();
-                    auto q_end = p.second.end();
-                    assert(q_begin != q_end);
-                    HASH h = f.hash(table::seeds[row]);
+                    auto& q = p.second;
+                    assert(!q.empty());
+                    HASH h = d.hash(table::seeds[row]);
                     HASH rem = h % table::WIDTH;
                     HASH quo = h / table::WIDTH;
-                    auto& hc = table::history[row][rem];
-                    for(auto c = table::first_history(hc, q_begin->first); c != hc.end(); c++) {
-                        if(q_begin == q_end) [[unlikely]]
+                    size_t i = 0;
+                    for(auto& c : table::overlapping(row, rem, q.front().first, q.back().first)) {
+                        if(i == q.size()) [[unlikely]]
                             break;
-                        q_begin = c->subtract(quo, q_begin, q_end);
+                        i = c.subtract(quo, q, i);
                     }
                 }
             }
         }
 
+        // the bucket of f in row
+        HASH bucket(flow_digest d, int row) const {
+            return d.hash(table::seeds[row]) % table::WIDTH;
+        }
+        // for every time of times, ascending, add the sum before it of the bucket of f in row to out, from the
+        // coefficients of the counters that may hold one of the times: the earlier ones add the same to every time
+        void add_prefix(flow_digest d, int row, span<const TIME> times, DATA* out) const {
+            for(auto& c : table::overlapping(row, bucket(d, row), times.front(), times.back()))
+                c.add_prefix(times, out);
+        }
+
         void list_min(vector<record>& result) const {
             for(int row = 0; row < table::HEIGHT; row++)
                 for(int col = 0; col < table::WIDTH; col++)
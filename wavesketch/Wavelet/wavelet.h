@@ -7,55 +7,187 @@
 
 using namespace std;
 
-template<bool BY_THRESHOLD = false>
-class wavelet : public abstract_scheme {
+template<bool BY_THRESHOLD = false, typename P = default_parameter>
+class wavelet {
 protected:
-    Wavelet::heavy<BY_THRESHOLD> top{};
-    Wavelet::table<BY_THRESHOLD> low{};
+    typedef Wavelet::record<P> record;
+    typedef Wavelet::counter<BY_THRESHOLD, P> counter;
+
+    Wavelet::heavy<BY_THRESHOLD, P> top{};
+    Wavelet::table<BY_THRESHOLD, P> low{};
 public:
-    void reset() override {
+    constexpr static const uint64_t KIND = codec::kind<P>("wavelet", BY_THRESHOLD);
+
+    void reset() {
+        counter::reseed();
         top.reset();
         low.reset();
     }
 
-    void count(const five_tuple& f, const TIME t, const DATA c) override {
-        top.count(f, t, c);
-        low.count(f, t, c);
+    void count(const five_tuple& f, flow_digest d, const TIME t, const DATA c) {
+        top.count(f, d, t, c);
+        low.count(f, d, t, c);
+    }
+    // both parts see each packet in turn: practical counters of both draw from one shared generator
+    void count_batch(span<const packet> batch) {
+        for(size_t i = 0; i < batch.size(); i++) {
+            if(i + PREFETCH_AHEAD < batch.size()) {
+                top.prefetch(batch[i + PREFETCH_AHEAD].digest);
+                low.prefetch(batch[i + PREFETCH_AHEAD].digest);
+            }
+            auto& p = batch[i];
+            top.count(p.flow, p.digest, p.time, p.data);
+            low.count(p.flow, p.digest, p.time, p.data);
+        }
     }
 
-    void flush() override {
+    void flush() {
         top.flush();
         low.flush();
     }
 
-    STREAM rebuild(const STREAM& dict) const override {
+    // the heavy part counts as one shard, every row of the light part as another; practical heavy and light
+    // parts draw from one generator in packet order, so they stay whole
+    constexpr static size_t shards() {
+        return !BY_THRESHOLD ? 1 + decltype(low)::row_shards() : 0;
+    }
+    void count_shard(size_t s, span<const packet> batch) {
+        if(s == 0)
+            top.count_batch(batch);
+        else
+            low.count_row(s - 1, batch);
+    }
+
+    STREAM rebuild(const STREAM& dict) const {
         STREAM heavy_dict;
-        for(auto& p : dict) {
-            auto& f = p.first;
-            auto& q = p.second;
-            auto temp = top.rebuild(f, q.front().first, q.back().first);
-            if(!temp.empty())
-                heavy_dict[f] = move(temp);
-        }
+        auto tops = rebuild_flows(dict, [this](const five_tuple& f, const STREAM_QUEUE& q) {
+            return top.rebuild(f, q.front().first, q.back().first);
+        });
+        for(auto& [f, q] : tops)
+            if(!q.empty())
+                heavy_dict[f] = move(q);
+        // subtraction writes the caches of shared counters, so it runs alone
         low.subtract(heavy_dict);
 
-        STREAM result;
-        for(auto& p : dict) {
-            auto& f = p.first;
-            auto& q = p.second;
-            STREAM_QUEUE q_top = heavy_dict[f];
+        const static STREAM_QUEUE none;
+        auto queues = rebuild_flows(dict, [&](const five_tuple& f, const STREAM_QUEUE& q) {
+            auto top_it = heavy_dict.find(f);
+            const STREAM_QUEUE& q_top = top_it != heavy_dict.end() ? top_it->second : none;
             STREAM_QUEUE q_low = low.rebuild(f, q.front().first, q.back().first);
-            STREAM_QUEUE& q_res = result[f];
+            STREAM_QUEUE q_res;
+            q_res.reserve(q_low.size());
             set_union(q_top.begin(), q_top.end(), q_low.begin(), q_low.end(), back_inserter(q_res),
-                      [](const pair<TIME, DATA>& l, const pair<TIME, DATA>& r) { return l.first < r.first; });
-        }
+                      [](const SAMPLE& l, const SAMPLE& r) { return l.first < r.first; });
+            return q_res;
+        });
+
+        STREAM result;
+        result.reserve(queues.size());
+        for(auto& [f, q] : queues)
+            result[f] = move(q);
 
         if(!BY_THRESHOLD)
             set_min();
         return result;
     }
 
-    size_t serialize() const override {
+    /* estimate of the sums of every flow of dict over the windows of 2^level ticks aligned to multiples of 2^level,
+     * clipped to its times in dict, as (window start, estimate), from the coefficients alone: no tick is rebuilt
+     *   times the heavy part holds for the flow sum its counters of it; the others take the least over rows of
+     *   the window's sum of the light bucket less the heavy flows of known sharing it.
+     * it bounds coarsen(rebuild(known)) in neither direction: rebuild takes the least tick by tick, which sums to
+     * no more, but lifts values at or below zero to one unit, which this skips, and rounds at every level down to
+     * the ticks once a counter has dropped coefficients. the two agree where one row holds the least at every
+     * tick, no tick is lifted and the counters kept every coefficient. window starts cut the coefficients at the
+     * window level; a flow's first and last ticks and the ends of its heavy spans fall anywhere and cut down to
+     * level 0, O(LEVEL) each */
+    STREAM window_estimate(const STREAM& dict, int level, const STREAM& known) const {
+        constexpr static const int ROWS = LESS_HEIGHT;
+        // heavy flows of known by their light bucket in every row
+        vector<pair<HASH, five_tuple>> shared[ROWS];
+        for(auto& h : top.labels())
+            if(known.contains(h))
+                for(int row = 0; row < ROWS; row++)
+                    shared[row].push_back({low.bucket(h.digest(), row), h});
+        for(auto& s : shared)
+            sort(s.begin(), s.end(), [](auto& l, auto& r) { return l.first < r.first; });
+
+        auto queues = rebuild_flows(dict, [&](const five_tuple& f, const STREAM_QUEUE& q) {
+            const TIME first = q.front().first, last = q.back().first;
+            const TIME base = first >> level;
+            const size_t windows = (last >> level) - base + 1;
+
+            // cut [first, last] at the window bounds and the ends of the heavy spans of f
+            vector<TIME> times;
+            for(size_t w = 0; w < windows; w++)
+                times.push_back(max<TIME>(first, (base + w) << level));
+            times.push_back(last + 1);
+            auto spans = top.spans(f, first, last);
+            for(auto [s, e] : spans)
+                if(s <= last && e >= first) {
+                    times.push_back(max(s, first));
+                    times.push_back(min(e, last) + 1);
+                }
+            sort(times.begin(), times.end());
+            times.erase(unique(times.begin(), times.end()), times.end());
+
+            // prefix sums at the cuts: of f in the heavy part, and of its light buckets less the heavy flows there
+            const size_t n = times.size();
+            vector<DATA> heavy(n, 0), light(n * ROWS, 0), other(n);
+            top.add_prefix(f, times, heavy.data());
+            flow_digest d = f.digest();
+            for(int row = 0; row < ROWS; row++) {
+                DATA* out = light.data() + row * n;
+                low.add_prefix(d, row, times, out);
+                auto [lo, hi] = equal_range(shared[row].begin(), shared[row].end(), pair(low.bucket(d, row), f),
+                                            [](auto& l, auto& r) { return l.first < r.first; });
+                for(auto it = lo; it != hi; it++) {
+                    fill(other.begin(), other.end(), 0);
+                    top.add_prefix(it->second, times, other.data());
+                    for(size_t i = 0; i < n; i++)
+                        out[i] -= other[i];
+                }
+            }
+
+            // every piece between two cuts lies within one window, and within a heavy span of f or outside all
+            vector<DATA> held(windows, 0), rest(windows * ROWS, 0);
+            for(size_t k = 0; k + 1 < n; k++) {
+                const size_t w = (times[k] >> level) - base;
+                bool covered = any_of(spans.begin(), spans.end(),
+                                      [t = times[k]](auto& s) { return s.first <= t && t <= s.second; });
+                if(covered)
+                    held[w] += heavy[k + 1] - heavy[k];
+                else
+                    for(int row = 0; row < ROWS; row++)
+                        rest[w * ROWS + row] += light[row * n + k + 1] - light[row * n + k];
+            }
+
+            STREAM_QUEUE result;
+            result.reserve(windows);
+            for(size_t w = 0; w < windows; w++) {
+                DATA least = *min_element(rest.begin() + w * ROWS, rest.begin() + (w + 1) * ROWS);
+                result.push_back((base + w) << level, held[w] + max<DATA>(least, 0));
+            }
+            return result;
+        });
+
+        STREAM result;
+        result.reserve(queues.size());
+        for(auto& [f, q] : queues)
+            result[f] = move(q);
+        return result;
+    }
+
+    // the heavy part, then the light one
+    void encode(codec::writer& out) const {
+        top.encode(out);
+        low.encode(out);
+    }
+    bool decode(codec::reader& in) {
+        return top.decode(in) && low.decode(in);
+    }
+
+    size_t serialize() const {
         size_t result = 0;
         result += top.serialize();
         result += low.serialize();
@@ -63,7 +195,7 @@ public:
     }
 
     void set_min() const {
-        vector<Wavelet::record> result = {};
+        vector<record> result = {};
         top.list_min(result);
         low.list_min(result);
 
@@ -84,13 +216,13 @@ public:
         // =======================================================
 
         sort(result.begin(), result.end());
-        auto t = result.begin() + result.size() * (SAMPLE_RATE + 10) / 128;
+        auto t = result.begin() + result.size() * (P::SAMPLE_RATE + 10) / 128;
         nth_element(result.begin(), t, result.end());
         auto m = result.begin() + result.size() * 3 / 4;
         nth_element(result.begin(), t, result.end());
         //auto m = max_element(result.begin(), result.end());
-        pseudo_heap<Wavelet::record, ROUND(FULL_DEPTH * 4 + 4 - 44, 4) / 2>::thresh_hi = Wavelet::record(992, 36 + SAMPLE_RATE * 2);//*m;
-        pseudo_heap<Wavelet::record, ROUND(FULL_DEPTH * 4 + 4 - 44, 4) / 2>::thresh_lo = *t;
+        pseudo_heap<record, counter::T_DEPTH>::thresh_hi = record(992, 36 + P::SAMPLE_RATE * 2);//*m;
+        pseudo_heap<record, counter::T_DEPTH>::thresh_lo = *t;
     }
 };
 
@@ -9,14 +9,16 @@ using namespace std;
 
 namespace WaveletAlt {
 
-    typedef STREAM_QUEUE::const_iterator SQptr;
 
-    template<unsigned QUEUE_N = 1>
+    template<unsigned QUEUE_N = 1, typename P = default_parameter>
     class counter : public abstract_counter {
+    public:
+        typedef WaveletAlt::record<P> record;
+        constexpr static const int DEPTH = ROUND(P::FULL_DEPTH * 4 + 4 - 42, 4) / QUEUE_N;
     protected:
-        constexpr static const int DEPTH = ROUND(FULL_DEPTH * 4 + 4 - 42, 4) / QUEUE_N;
-        // # of data read
-        uint16_t read_count{};
+        constexpr static const int LEVEL = P::LEVEL;
+        // # of data read, up to MAX_LENGTH
+        uint32_t read_count{};
         DATA value{};
 
         array<DATA, LEVEL> last_coef{};
@@ -24,9 +26,7 @@ namespace WaveletAlt {
 
         heap<record, DEPTH> detail[QUEUE_N]{};
 
-        interval time{};
-
-        mutable STREAM_QUEUE cache{};
+        interval<P> time{};
 
         void heap_insert(uint8_t level, DATA d) {
             uint16_t pos = (read_count >> level) << level;
@@ -41,26 +41,19 @@ namespace WaveletAlt {
             heap_insert(level, hi);
             return lo;
         }
-        static void inverse_transform(DATA& lo, DATA& hi) {
-            DATA l = (lo + hi) / 2;
-            DATA h = (lo - hi) / 2;
-            lo = l;
-            hi = h;
-        }
     public:
-        uint16_t get_count() const {
+        uint32_t get_count() const {
             return read_count;
         }
-        void reset() override {
+        void reset() {
             read_count = 0;
             value = 0;
             for(auto& d : detail)
                 d.reset();
             time.reset();
-            cache.clear();
         }
 
-        bool count(TIME t, HASH h, DATA c) override {
+        bool count(TIME t, HASH h, DATA c) {
             DATA sign = h % 2 ? c : -c;
             if(time.same_as_last(t)) {
                 value += sign;
@@ -77,11 +70,11 @@ namespace WaveletAlt {
             return false;
         }
 
-        void flush() override {
+        void flush() {
             if(empty())
                 return;
 
-            int level = countr_one(read_count & INDEX_MASK);
+            int level = countr_one(read_count & P::INDEX_MASK);
             DATA last_val = value;
             for(int l = 0; l < level; l++)
                 last_val = transform_pair(l, last_val);
@@ -95,89 +88,270 @@ namespace WaveletAlt {
             value = 0;
         }
 
-        STREAM_QUEUE rebuild(HASH h) const override {
-            assert(!empty());
-            DATA sign = h % 2 ? 1 : -1;
-            if(cache.empty()) {
-                cache = time.rebuild({});
-
-                vector<DATA> temp(read_count, 0);
-                // copy heap data
-                for(auto& d : detail)
-                    for(int i = 0; i < d.size; i++) {
-                        int pos = d.heap_data[i].pos;
-                        temp[pos] = d.heap_data[i].data();
-                    }
+        bool empty() const {
+            return time.empty();
+        }
 
-                // copy top level
+        TIME start() const {
+            return time.start();
+        }
+
+        size_t serialize() const {
+            size_t result = 0;
+            result += time.serialize();
+            result += sizeof(read_count);
+            result += sizeof(DATA) * popcount(read_count & P::INDEX_MASK);
+            result += sizeof(DATA) * min<uint32_t>(RESERVED, read_count >> LEVEL);
+            for(auto& d : detail)
+                result += d.serialize();
+            return result;
+        }
+
+        /* finished counter as kept in history: only the coefficients, time gaps and records in use,
+         * stored in a row arena as
+         *   header | last_coef of the set bits of read_count | top_level | time gaps | records
+         * the rebuild cache comes from the same arena on first use */
+        class sealed {
+            typedef typename interval<P>::gap gap;
+            struct header {
+                TIME start_time;
+                TIME last_time;
+                Wavelet::TIME_DIFF period;
+                uint16_t gaps;
+                uint32_t read_count;
+                uint16_t size;
+            };
+
+            const header* head;
+            arena* home;
+            // rebuilt unsigned values less whatever subtract took away
+            mutable SAMPLE* cache = nullptr;
+            // work of the rebuild_range calls that skipped the cache so far
+            mutable uint32_t spent = 0;
+
+            int coef_count() const {
+                return popcount(head->read_count & P::INDEX_MASK);
+            }
+            int top_count() const {
+                return min<uint32_t>(RESERVED, head->read_count >> LEVEL);
+            }
+            const DATA* coefs() const {
+                return reinterpret_cast<const DATA*>(head + 1);
+            }
+            span<const gap> gaps() const {
+                return {reinterpret_cast<const gap*>(coefs() + coef_count() + top_count()), head->gaps};
+            }
+            const record* records() const {
+                return reinterpret_cast<const record*>(gaps().data() + head->gaps);
+            }
+            sealed(const header* h, arena& a) : head(h), home(&a) {}
+            span<SAMPLE> values() const {
+                const size_t size = interval<P>::times(head->period, gaps());
+                return {cache_once(cache, *home, size, [this](SAMPLE* out) { build(out); }), size};
+            }
+            // call f(pos, coefficient) in transform order; a later one replaces an earlier one at the same pos
+            template<typename F>
+            void each_coefficient(F&& f) const {
+                const uint32_t read_count = head->read_count;
+
+                // heap data
+                auto r = records();
+                for(int i = 0; i < head->size; i++)
+                    f(r[i].pos, r[i].data());
+
+                // top level
+                const DATA* v = coefs() + coef_count();
                 for(int i = 0; i < read_count >> LEVEL; i++)
-                    temp[i << LEVEL] = top_level[i];
+                    f(i << LEVEL, v[i]);
 
-                // copy data yet to be transformed
+                // data yet to be transformed
+                v = coefs();
                 bitset<16> mask{read_count};
                 for(int i = 0; i < LEVEL; i++)
                     if (mask[i])
-                        temp[(read_count >> (i + 1)) << (i + 1)] = last_coef[i];
-
-                // inverse-transform each section except for the last one
-                uint16_t last_section = (read_count >> LEVEL) << LEVEL;
-                for(uint32_t frag = 0; frag < last_section; frag += 1 << LEVEL) {
-                    for (uint32_t p = 1 << LEVEL; p > 0; p--) {
-                        uint32_t pos = frag + p;
-                        for (int i = countr_zero(p) - 1; i >= 0; i--) {
-                            inverse_transform(temp[pos - (2 << i)], temp[pos - (1 << i)]);
-                        }
-                    }
+                        f((read_count >> (i + 1)) << (i + 1), *v++);
+            }
+            void build(SAMPLE* out) const {
+                const uint32_t read_count = head->read_count;
+                const size_t size = interval<P>::times(head->period, gaps());
+                interval<P>::timestamps(head->last_time, head->period, gaps(), out + size);
+
+                // one slot per read time; coefficients in transform order, then the values in place
+                assert(size == read_count);
+                thread_local vector<DATA> coef;
+                coef.assign(read_count, 0);
+                each_coefficient([](uint32_t pos, DATA d) { coef[pos] = d; });
+                haar::inverse(coef.data(), read_count, LEVEL);
+
+                for(size_t pos = 0; pos < size; pos++)
+                    out[pos].second = coef[pos] > 0 ? coef[pos] : 1;
+            }
+        public:
+            sealed(const counter& c, arena& a) : home(&a) {
+                size_t size = 0;
+                for(auto& d : c.detail)
+                    size += d.size;
+                auto g = c.time.gaps();
+                int coefs = popcount(c.read_count & P::INDEX_MASK);
+                int tops = min<uint32_t>(RESERVED, c.read_count >> LEVEL);
+                auto h = a.allocate<header>(sizeof(header) + sizeof(DATA) * (coefs + tops) +
+                                            sizeof(gap) * g.size() + sizeof(record) * size);
+                *h = {c.time.start(), c.time.last(), c.time.last_period(), (uint16_t)g.size(), c.read_count,
+                      (uint16_t)size};
+
+                auto v = reinterpret_cast<DATA*>(h + 1);
+                for(int i = 0; i < LEVEL; i++)
+                    if((c.read_count >> i) & 1)
+                        *v++ = c.last_coef[i];
+                v = copy_n(c.top_level.begin(), tops, v);
+                auto r = reinterpret_cast<record*>(copy(g.begin(), g.end(), reinterpret_cast<gap*>(v)));
+                for(auto& d : c.detail)
+                    r = copy_n(d.heap_data, d.size, r);
+                head = h;
+            }
+
+            auto rebuild(HASH h) const {
+                DATA sign = h % 2 ? 1 : -1;
+                return values() | views::transform([sign](SAMPLE p) {
+                    p.second = sign * p.second > 0 ? sign * p.second : 1;
+                    return p;
+                });
+            }
+
+            // the values of rebuild at times [first, last]: only the coefficients above the range, into a buffer of
+            // the calling thread that lives until its next rebuild_range, while such calls cost less in total than
+            // the cache; a slice of the cache otherwise
+            auto rebuild_range(HASH h, TIME first, TIME last) const {
+                thread_local vector<SAMPLE> result;
+                // the read times within [first, last] hold the slots [lo, lo + result.size())
+                size_t lo = 0, pos = 0;
+                result.clear();
+                interval<P>::runs(head->start_time, head->period, gaps(), [&](TIME t, size_t n) {
+                    if(t < first)
+                        lo = pos + min<size_t>(n, first - t);
+                    for(TIME u = max(t, first); u < t + n && u <= last; u++)
+                        result.push_back({u, 0});
+                    pos += n;
+                });
+
+                span<SAMPLE> slots = result;
+                const bool cached = atomic_ref<SAMPLE*>(cache).load(memory_order_acquire) != nullptr;
+                const size_t cost = coef_count() + top_count() + head->size + head->gaps + result.size();
+                if(!result.empty() && (cached || !rent_part(spent, cost, head->read_count)))
+                    slots = values().subspan(lo, result.size());
+                else if(!result.empty()) {
+                    thread_local vector<haar::coefficient> coef;
+                    thread_local vector<DATA> temp;
+                    coef.clear();
+                    each_coefficient([](uint32_t pos, DATA d) { coef.push_back({pos, d}); });
+                    temp.resize(result.size());
+                    haar::inverse_range(coef, head->read_count, LEVEL, lo, lo + result.size() - 1, temp.data());
+                    for(size_t i = 0; i < result.size(); i++)
+                        result[i].second = temp[i] > 0 ? temp[i] : 1;
                 }
 
-                // inverse-transform the last section
-                for(uint32_t pos = read_count; pos > last_section; pos--)
-                    for(int i = countr_zero(pos) - 1; i >= 0; i--)
-                        inverse_transform(temp[pos - (2 << i)], temp[pos - (1 << i)]);
+                DATA sign = h % 2 ? 1 : -1;
+                return slots | views::transform([sign](SAMPLE p) {
+                    p.second = sign * p.second > 0 ? sign * p.second : 1;
+                    return p;
+                });
+            }
 
-                // copy from temp to result
-                for(int pos = 0; pos < cache.size(); pos++)
-                    cache[pos].second = temp[pos] > 0 ? temp[pos] : 1;
+            // given a precisely-recorded flow q, subtract its values from index i on from every recorded
+            // time-window; return the index of the first value past this counter
+            size_t subtract(HASH h, const STREAM_QUEUE& q, size_t i) const {
+                auto cached = values();
+
+                DATA sign = h % 2 ? 1 : -1;
+                auto cache_it = upper_bound(cached.begin(), cached.end(), q.time(i),
+                                            [](const TIME& t, const auto& p) { return t <= p.first; });
+
+                while(i < q.size() && cache_it != cached.end()) {
+                    if(q.time(i) > cache_it->first)
+                        cache_it++;
+                    else if(q.time(i) < cache_it->first)
+                        i++;
+                    else [[likely]] {
+                        cache_it->second -= sign * q.value(i);
+                        i++;
+                        cache_it++;
+                    }
+                }
+
+                return i;
             }
 
-            STREAM_QUEUE result = cache;
-            for(auto& p : result)
-                p.second = sign * p.second > 0 ? sign * p.second : 1;
-            return result;
-        }
+            TIME start() const {
+                return head->start_time;
+            }
 
-        // given a precisely-recorded flow, subtract its value from every recorded time-window
-        SQptr subtract(HASH h, SQptr it, const SQptr& end) const {
-            assert(!empty());
-            if(cache.empty()) [[unlikely]] {
-                rebuild(h);
-            }
-
-            DATA sign = h % 2 ? 1 : -1;
-            auto cache_it = upper_bound(cache.begin(), cache.end(), it->first,
-                                        [](const TIME& t, const auto& p) { return t <= p.first; });
-
-            while(it != end && cache_it != cache.end()) {
-                if(it->first > cache_it->first)
-                    cache_it++;
-                else if(it->first < cache_it->first)
-                    it++;
-                else [[likely]] {
-                    cache_it->second -= sign * it->second;
-                    it++;
-                    cache_it++;
+            // period, the gaps, read_count and the record count, the coefficients zigzag-coded, then the records
+            // packed; the last time follows from the start, the gaps and period
+            void encode(codec::writer& out) const {
+                out.varint(head->period);
+                out.varint(head->gaps);
+                for(auto& g : gaps()) {
+                    out.varint(g.first);
+                    out.varint(g.second);
                 }
+                out.varint(head->read_count);
+                out.varint(head->size);
+                for(int i = 0; i < coef_count() + top_count(); i++)
+                    out.zigzag(coefs()[i]);
+                record::pack(out, {records(), head->size});
+            }
+            static sealed decode(codec::reader& in, arena& a, TIME start) {
+                constexpr static const uint16_t most = numeric_limits<uint16_t>::max();
+                const Wavelet::TIME_DIFF period = in.bounded(most);
+                const uint16_t count = in.bounded(min<uint32_t>(P::MAX_LENGTH / 2, most));
+                thread_local vector<gap> g;
+                g.resize(count);
+                // the last time stays within MAX_LENGTH of the start, as overlapping assumes
+                uint64_t span = 0;
+                for(auto& [run, skip] : g) {
+                    run = in.bounded(most);
+                    skip = in.bounded(most);
+                    span += run + skip + 2;
+                }
+                span += period;
+                if(span >= P::MAX_LENGTH)
+                    in.fail();
+                const TIME last = start + span;
+                const uint32_t read_count = in.bounded(P::MAX_LENGTH);
+                const uint16_t size = in.bounded(DEPTH * QUEUE_N);
+                // one coefficient slot per read time
+                if(read_count != interval<P>::times(period, g))
+                    in.fail();
+
+                const int coefs = popcount(read_count & P::INDEX_MASK);
+                const int tops = min<uint32_t>(RESERVED, read_count >> LEVEL);
+                auto h = a.allocate<header>(sizeof(header) + sizeof(DATA) * (coefs + tops) + sizeof(gap) * count +
+                                            sizeof(record) * size);
+                *h = {start, last, period, count, read_count, size};
+                auto v = reinterpret_cast<DATA*>(h + 1);
+                for(int i = 0; i < coefs + tops; i++)
+                    v[i] = in.within(numeric_limits<DATA>::min(), numeric_limits<DATA>::max());
+                auto r = reinterpret_cast<record*>(copy(g.begin(), g.end(), reinterpret_cast<gap*>(v + coefs + tops)));
+                record::unpack(in, r, size, read_count);
+                return sealed(h, a);
             }
 
-            return it;
-        }
-
-        bool empty() const override {
-            return time.empty();
-        }
+            // same count as counter::serialize before sealing
+            size_t serialize() const {
+                size_t result = 0;
+                result += interval<P>::serialize(head->gaps);
+                result += sizeof(head->read_count);
+                result += sizeof(DATA) * (coef_count() + top_count());
+                // one size field per heap
+                result += sizeof(uint16_t) * QUEUE_N;
+                for(int i = 0; i < head->size; i++)
+                    result += records()[i].serialize();
+                return result;
+            }
+        };
 
-        TIME start() const override {
-            return time.start();
+        sealed seal(arena& a) const {
+            return sealed(*this, a);
         }
     };
 
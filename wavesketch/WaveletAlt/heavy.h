@@ -8,8 +8,8 @@ using namespace std;
 
 namespace WaveletAlt {
 
-    template<unsigned QUEUE_N = 1>
-    class heavy : public Wavelet::heavy<QUEUE_N> {
+    template<unsigned QUEUE_N = 1, typename P = default_parameter>
+    class heavy : public Wavelet::heavy<(QUEUE_N > 1), P> {
 
     };
 
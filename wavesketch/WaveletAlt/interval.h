@@ -8,7 +8,8 @@ using namespace std;
 
 namespace WaveletAlt {
 
-    typedef Wavelet::interval interval;
+    template<typename P = default_parameter>
+    using interval = Wavelet::interval<P>;
 
 } // WaveletAlt
 
@@ -8,7 +8,8 @@ using namespace std;
 
 namespace WaveletAlt {
 
-    typedef Wavelet::record record;
+    template<typename P = default_parameter>
+    using record = Wavelet::record<P>;
 
 } // WaveletAlt
 
@@ -8,28 +8,28 @@ using namespace std;
 
 namespace WaveletAlt {
 
-    template<unsigned QUEUE_N = 1>
-    class table : public basic_table<counter<QUEUE_N>, HALF_WIDTH, FULL_HEIGHT> {
+    template<unsigned QUEUE_N = 1, typename P = default_parameter>
+    class table : public basic_table<table<QUEUE_N, P>, P, counter<QUEUE_N, P>, P::HALF_WIDTH, FULL_HEIGHT> {
+        friend typename table::table_base;
     protected:
-        DATA select_val(vector<DATA>& vals) const override {
+        DATA select_val(array<DATA, table::HEIGHT>& vals) const {
             return table::select_median(vals);
         }
     public:
         // for every flow from heavy-hitter table, subtract its value from the corresponding counter
         void subtract(const STREAM& dict) const {
             for(auto& p : dict) {
+                flow_digest d = p.first.digest();
                 for(int row = 0; row < table::HEIGHT; row++) {
-                    auto& f = p.first;
-                    auto q_begin = p.second.begin();
-                    auto q_end = p.second.end();
-                    assert(q_begin != q_end);
-                    HASH h = f.hash(table::seeds[row]);
+                    auto& q = p.second;
+                    assert(!q.empty());
+                    HASH h = d.hash(table::seeds[row]);
                     HASH rem = h % table::WIDTH;
                     HASH quo = h / table::WIDTH;
-                    auto& hc = table::history[row][rem];
-                    for(auto c = table::first_history(hc, q_begin->first); c != hc.end(); c++) {
-                        q_begin = c->subtract(quo, q_begin, q_end);
-                        if(q_begin == q_end) [[unlikely]]
+                    size_t i = 0;
+                    for(auto& c : table::overlapping(row, rem, q.front().first, q.back().first)) {
+                        i = c.subtract(quo, q, i);
+                        if(i == q.size()) [[unlikely]]
                             break;
                     }
                 }
@@ -7,53 +7,93 @@
 
 using namespace std;
 
-template<unsigned QUEUE_N = 1>
-class wavelet_alt : public abstract_scheme {
+template<unsigned QUEUE_N = 1, typename P = default_parameter>
+class wavelet_alt {
 protected:
-    WaveletAlt::heavy<QUEUE_N> top{};
-    WaveletAlt::table<QUEUE_N> low{};
+    WaveletAlt::heavy<QUEUE_N, P> top{};
+    WaveletAlt::table<QUEUE_N, P> low{};
 public:
-    void reset() override {
+    constexpr static const uint64_t KIND = codec::kind<P>("wavelet_alt", QUEUE_N);
+
+    void reset() {
         top.reset();
         low.reset();
     }
 
-    void count(const five_tuple& f, const TIME t, const DATA c) override {
-        top.count(f, t, c);
-        low.count(f, t, c);
+    void count(const five_tuple& f, flow_digest d, const TIME t, const DATA c) {
+        top.count(f, d, t, c);
+        low.count(f, d, t, c);
+    }
+    void count_batch(span<const packet> batch) {
+        for(size_t i = 0; i < batch.size(); i++) {
+            if(i + PREFETCH_AHEAD < batch.size()) {
+                top.prefetch(batch[i + PREFETCH_AHEAD].digest);
+                low.prefetch(batch[i + PREFETCH_AHEAD].digest);
+            }
+            auto& p = batch[i];
+            top.count(p.flow, p.digest, p.time, p.data);
+            low.count(p.flow, p.digest, p.time, p.data);
+        }
     }
 
-    void flush() override {
+    void flush() {
         top.flush();
         low.flush();
     }
 
-    STREAM rebuild(const STREAM& dict) const override {
+    // the heavy part counts as one shard, every row of the light part as another
+    constexpr static size_t shards() {
+        static_assert(decltype(low)::row_shards() > 0);
+        return 1 + decltype(low)::row_shards();
+    }
+    void count_shard(size_t s, span<const packet> batch) {
+        if(s == 0)
+            top.count_batch(batch);
+        else
+            low.count_row(s - 1, batch);
+    }
+
+    STREAM rebuild(const STREAM& dict) const {
         STREAM heavy_dict;
-        for(auto& p : dict) {
-            auto& f = p.first;
-            auto& q = p.second;
-            auto temp = top.rebuild(f, q.front().first, q.back().first);
-            if(!temp.empty())
-                heavy_dict[f] = move(temp);
-        }
+        auto tops = rebuild_flows(dict, [this](const five_tuple& f, const STREAM_QUEUE& q) {
+            return top.rebuild(f, q.front().first, q.back().first);
+        });
+        for(auto& [f, q] : tops)
+            if(!q.empty())
+                heavy_dict[f] = move(q);
+        // subtraction writes the caches of shared counters, so it runs alone
         low.subtract(heavy_dict);
 
-        STREAM result;
-        for(auto& p : dict) {
-            auto& f = p.first;
-            auto& q = p.second;
-            STREAM_QUEUE q_top = heavy_dict[f];
+        const static STREAM_QUEUE none;
+        auto queues = rebuild_flows(dict, [&](const five_tuple& f, const STREAM_QUEUE& q) {
+            auto top_it = heavy_dict.find(f);
+            const STREAM_QUEUE& q_top = top_it != heavy_dict.end() ? top_it->second : none;
             STREAM_QUEUE q_low = low.rebuild(f, q.front().first, q.back().first);
-            STREAM_QUEUE& q_res = result[f];
+            STREAM_QUEUE q_res;
+            q_res.reserve(q_low.size());
             set_union(q_top.begin(), q_top.end(), q_low.begin(), q_low.end(), back_inserter(q_res),
-                      [](const pair<TIME, DATA>& l, const pair<TIME, DATA>& r) { return l.first < r.first; });
-        }
+                      [](const SAMPLE& l, const SAMPLE& r) { return l.first < r.first; });
+            return q_res;
+        });
+
+        STREAM result;
+        result.reserve(queues.size());
+        for(auto& [f, q] : queues)
+            result[f] = move(q);
 
         return result;
     }
 
-    size_t serialize() const override {
+    // the heavy part, then the light one
+    void encode(codec::writer& out) const {
+        top.encode(out);
+        low.encode(out);
+    }
+    bool decode(codec::reader& in) {
+        return top.decode(in) && low.decode(in);
+    }
+
+    size_t serialize() const {
         size_t result = 0;
         result += top.serialize();
         result += low.serialize();
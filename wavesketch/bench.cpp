@@ -0,0 +1,332 @@
+#include <iostream>
+#include "Utility/headers.h"
+#include "config.h"
+#include "registry.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+using namespace std;
+
+/* ingest microbenchmark: count() of every scheme over a synthetic trace
+ *   flows follow a zipf popularity, arrivals a poisson process of pps packets per second */
+struct workload {
+    uint32_t flows = 10000;
+    double zipf = 1.0;
+    size_t packets = 1000000;
+    double pps = 10e6;
+    uint32_t warmup = 1;
+    uint32_t reps = 5;
+    uint64_t seed = 0x5EED;
+    // time the hashing kernels instead of the schemes
+    bool hash = false;
+    // time encode and decode of the counted schemes instead of counting
+    bool codec = false;
+    // count_batch sizes to time against per-packet count
+    vector<size_t> batches = {16, 64, 256};
+};
+
+static uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static vector<packet> generate(const workload& w) {
+    mt19937_64 gen(w.seed);
+
+    // cumulative zipf weights of flow ranks
+    vector<double> cdf(w.flows);
+    double sum = 0.;
+    for(uint32_t i = 0; i < w.flows; i++) {
+        sum += 1. / pow(i + 1., w.zipf);
+        cdf[i] = sum;
+    }
+    uniform_real_distribution<> rank(0., sum);
+    exponential_distribution<> gap(w.pps * 1e-9);
+    bernoulli_distribution large(0.5);
+
+    vector<packet> result;
+    result.reserve(w.packets);
+    double now = 0.;
+    for(size_t i = 0; i < w.packets; i++) {
+        now += gap(gen);
+        uint32_t r = lower_bound(cdf.begin(), cdf.end(), rank(gen)) - cdf.begin();
+        five_tuple f(min(r, w.flows - 1) * 2654435761u);
+        DATA len = settings.by_bytes ? (large(gen) ? 1500 : 64) : 1;
+        result.push_back({f, f.digest(), (TIME)(now / TIMESCALE) + 1, len});
+    }
+    return result;
+}
+
+static bool parse_bench_option(workload& w, const string& key, const string& value) {
+    try {
+        if(key == "flows")
+            w.flows = stoul(value);
+        else if(key == "zipf")
+            w.zipf = stod(value);
+        else if(key == "packets")
+            w.packets = stoull(value);
+        else if(key == "pps")
+            w.pps = stod(value);
+        else if(key == "warmup")
+            w.warmup = stoul(value);
+        else if(key == "reps")
+            w.reps = stoul(value);
+        else if(key == "seed")
+            w.seed = stoull(value);
+        else if(key == "hash")
+            w.hash = value != "0";
+        else if(key == "codec")
+            w.codec = value != "0";
+        else if(key == "batch") {
+            w.batches.clear();
+            stringstream ss(value);
+            string size;
+            while(getline(ss, size, ','))
+                if(stoull(size) > 0)
+                    w.batches.push_back(stoull(size));
+        }
+        else
+            return set_option(settings, key, value);
+    } catch(const exception&) {
+        return false;
+    }
+    return true;
+}
+
+static void print_bench_usage(const char* program) {
+    cerr << "usage: " << program << " [--key value | --key=value]...\n"
+         << "  --flows N              distinct flows (default 10000)\n"
+         << "  --zipf S               popularity skew, 0 for uniform (default 1.0)\n"
+         << "  --packets N            packets per repetition (default 1000000)\n"
+         << "  --pps R                mean arrival rate, packets per second (default 1e7)\n"
+         << "  --warmup N --reps N    untimed and timed passes per scheme (default 1, 5)\n"
+         << "  --seed N               workload seed\n"
+         << "  --batch N,N,...        count_batch sizes timed against count (default 16,64,256)\n"
+         << "  --hash                 time the hashing kernels against scalar ones instead\n"
+         << "  --codec                time encode and decode of every scheme after counting instead, in GB/s\n"
+         << "                         of the binary form, and check the decoded schemes rebuild the same\n"
+         << "  --ingest-jobs N        time count_rows on N row workers per scheme instead of count_batch,\n"
+         << "                         through flush\n"
+         << "  --schemes, --width, --rate, --length, --by-bytes as in niffler (default: every scheme)\n";
+}
+
+// every flow of trace with its data summed per tick
+static STREAM sum_trace(const vector<packet>& trace) {
+    STREAM dict;
+    for(auto& p : trace) {
+        auto& q = dict[p.flow];
+        if(!q.empty() && q.back().first == p.time)
+            q.value(q.size() - 1) += p.data;
+        else
+            q.push_back(p.time, p.data);
+    }
+    return dict;
+}
+
+// count trace into the first scheme of e's chain and rebuild dict from it, as niffler runs it before e: the later
+// schemes of a chain count against the state its rebuild leaves, as the Practical wavelets on Ideal's thresholds
+static void seed_chain(const scheme_entry& e, const vector<packet>& trace, const STREAM& dict) {
+    if(e.chain == 0)
+        return;
+    auto head = find_if(scheme_registry().begin(), scheme_registry().end(), [&](const scheme_entry& h) {
+        return h.chain == e.chain && h.width == e.width && h.rate == e.rate && h.length == e.length;
+    });
+    if(&*head == &e)
+        return;
+    auto model = head->create();
+    for(size_t lo = 0; lo < trace.size(); lo += 256)
+        model->count_batch(span(trace).subspan(lo, min<size_t>(256, trace.size() - lo)));
+    model->flush();
+    model->rebuild(dict);
+}
+
+// time f over every key, return ns per key of the fastest repetition
+template<typename F>
+static double time_kernel(const workload& w, size_t keys, F&& f) {
+    double best = numeric_limits<double>::max();
+    for(uint32_t r = 0; r < w.warmup + w.reps; r++) {
+        auto start_time = chrono::steady_clock::now();
+        f();
+        chrono::duration<double, nano> time_diff = chrono::steady_clock::now() - start_time;
+        if(r >= w.warmup)
+            best = min(best, time_diff.count() / keys);
+    }
+    return best;
+}
+
+// compare hash_simd::active with the scalar kernels on w.packets random five-tuples; false on any mismatch
+static bool bench_hash(const workload& w) {
+    mt19937 gen(w.seed);
+    vector<five_tuple> keys;
+    for(size_t i = 0; i < w.packets; i++)
+        keys.emplace_back(gen(), gen(), gen(), gen(), gen() & 1 ? 6 : 17);
+    const size_t n = keys.size();
+    bool identical = true;
+
+    cout << "kernel,op,keys,ns/key,mkeys/s,identical" << endl;
+    auto report = [&](const char* name, const char* op, double ns, bool same) {
+        cout << name << "," << op << "," << n << "," << ns << "," << 1e3 / ns << "," << same << endl;
+        identical &= same;
+    };
+    for(auto& k : {hash_simd::scalar, hash_simd::active}) {
+        vector<flow_digest> digest(n);
+        double ns = time_kernel(w, n, [&]() { k.digest(keys.data(), n, digest.data()); });
+        report(k.name, "digest", ns, all_of(keys.begin(), keys.end(), [&](const five_tuple& f) {
+            return digest[&f - keys.data()].mix == f.digest().mix;
+        }));
+
+    }
+    return identical;
+}
+
+// encode every selected scheme after counting trace and decode it into a fresh one; false unless every decoded
+// scheme rebuilds every flow of trace as the encoded one did
+static bool bench_codec(const workload& w, const vector<packet>& trace, const STREAM& dict,
+                        const vector<methods>& selected) {
+    auto same = [](const STREAM& l, const STREAM& r) {
+        return l.size() == r.size() && all_of(l.begin(), l.end(), [&](auto& p) {
+            auto it = r.find(p.first);
+            return it != r.end() && equal(p.second.begin(), p.second.end(), it->second.begin(), it->second.end());
+        });
+    };
+    bool identical = true;
+
+    cout << "class,memory,bytes,serialize-bytes,encode-GB/s,decode-GB/s,identical" << endl;
+    for(auto& e : scheme_registry()) {
+        if(e.width != settings.width || e.rate != settings.rate || e.length != settings.length)
+            continue;
+        if(!selected.empty() && find(selected.begin(), selected.end(), e.method) == selected.end())
+            continue;
+
+        seed_chain(e, trace, dict);
+        auto model = e.create();
+        for(size_t lo = 0; lo < trace.size(); lo += 256)
+            model->count_batch(span(trace).subspan(lo, min<size_t>(256, trace.size() - lo)));
+        model->flush();
+        vector<BYTE> blob;
+        if(!model->encode(blob))
+            continue;
+        double encode_ns = time_kernel(w, 1, [&]() {
+            blob.clear();
+            model->encode(blob);
+        });
+        auto loaded = e.create();
+        bool decoded = true;
+        double decode_ns = time_kernel(w, 1, [&]() { decoded &= loaded->decode(blob); });
+        bool result = decoded && same(loaded->rebuild(dict), model->rebuild(dict));
+
+        cout << e.method << "," << e.memory << "," << blob.size() << "," << model->serialize() << ","
+             << blob.size() / encode_ns << "," << blob.size() / decode_ns << "," << result << endl;
+        identical &= result;
+    }
+    return identical;
+}
+
+int main(int argc, char* argv[]) {
+    workload w;
+    settings.schemes.clear();
+    for(int i = 1; i < argc; i++) {
+        string key = argv[i];
+        if(!key.starts_with("--")) {
+            print_bench_usage(argv[0]);
+            return -1;
+        }
+        key = key.substr(2);
+        string value = "1";
+        auto eq = key.find('=');
+        if(eq != string::npos) {
+            value = key.substr(eq + 1);
+            key = key.substr(0, eq);
+        } else if(key != "by-bytes" && key != "hash" && key != "codec" && i + 1 < argc)
+            value = argv[++i];
+        if(key == "help" || !parse_bench_option(w, key, value)) {
+            print_bench_usage(argv[0]);
+            return key == "help" ? 0 : -1;
+        }
+    }
+    if(w.flows == 0 || w.packets == 0 || w.pps <= 0 || w.reps == 0) [[unlikely]] {
+        print_bench_usage(argv[0]);
+        return -1;
+    }
+    double seconds = w.packets / w.pps;
+    if(seconds * 1e9 / TIMESCALE >= settings.length)
+        cerr << "warning: " << seconds << "s of traffic exceeds the sketch length" << endl;
+
+    vector<methods> selected;
+    for(auto& name : settings.schemes) {
+        methods m;
+        if(!parse_method(name, m)) {
+            cerr << "unknown scheme: " << name << endl;
+            print_bench_usage(argv[0]);
+            return -1;
+        }
+        selected.push_back(m);
+    }
+
+    if(w.hash)
+        return bench_hash(w) ? 0 : -1;
+    auto trace = generate(w);
+    auto dict = sum_trace(trace);
+    if(w.codec)
+        return bench_codec(w, trace, dict, selected) ? 0 : -1;
+    cerr << "100GbE line rate: 148.8 Mpps at 64B, 8.2 Mpps at 1500B" << endl;
+    // digests are precomputed as the loaders do, so batch 0 (per-packet count) and count_batch differ
+    // only in batching and prefetch
+    cout << "class,memory,flows,zipf,pps,packets,batch,ns/packet,mpps,cycles/packet,best-ns/packet,speedup"
+         << endl;
+    for(auto& e : scheme_registry()) {
+        if(e.width != settings.width || e.rate != settings.rate || e.length != settings.length)
+            continue;
+        if(!selected.empty() && find(selected.begin(), selected.end(), e.method) == selected.end())
+            continue;
+
+        seed_chain(e, trace, dict);
+        auto model = e.create();
+        double base_ns = 0.;
+        vector<size_t> sizes = {0};
+        sizes.insert(sizes.end(), w.batches.begin(), w.batches.end());
+        for(auto size : sizes) {
+            double total_ns = 0., best_ns = numeric_limits<double>::max();
+            uint64_t total_cycles = 0;
+            for(uint32_t r = 0; r < w.warmup + w.reps; r++) {
+                model->reset();
+                auto start_time = chrono::steady_clock::now();
+                uint64_t start_cycles = cycles();
+                if(size == 0) {
+                    for(auto& p : trace)
+                        model->count(p.flow, p.digest, p.time, p.data);
+                } else if(settings.ingest_jobs == 1) {
+                    for(size_t lo = 0; lo < trace.size(); lo += size)
+                        model->count_batch(span(trace).subspan(lo, min(size, trace.size() - lo)));
+                } else {
+                    // row workers may still be counting when count_rows returns; flush waits for them
+                    for(size_t lo = 0; lo < trace.size(); lo += size)
+                        model->count_rows(span(trace).subspan(lo, min(size, trace.size() - lo)), settings.ingest_jobs);
+                    model->flush();
+                }
+                uint64_t end_cycles = cycles();
+                chrono::duration<double, nano> time_diff = chrono::steady_clock::now() - start_time;
+                if(r < w.warmup)
+                    continue;
+                total_ns += time_diff.count();
+                best_ns = min(best_ns, time_diff.count());
+                total_cycles += end_cycles - start_cycles;
+            }
+
+            double packets = (double)w.packets * w.reps;
+            double ns = total_ns / packets;
+            if(size == 0)
+                base_ns = ns;
+            cout << e.method << "," << e.memory << "," << w.flows << "," << w.zipf << "," << w.pps << ","
+                 << w.packets << "," << size << "," << ns << "," << 1e3 / ns << "," << total_cycles / packets
+                 << "," << best_ns / w.packets << "," << base_ns / ns << endl;
+        }
+    }
+
+    return 0;
+}
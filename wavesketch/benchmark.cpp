@@ -124,22 +124,33 @@ ostream& operator<<(ostream& os, const methods& t) {
         case methods::WAVE_ALT_P:
             os << "Wavelet-Alt-Practical"; break;
         case methods::REFERENCE:
-            os << "dst" << breakpoint.dst_ip; break;
+            os << "dst" << settings.breakpoint.dst_ip; break;
     }
     return os;
 }
 
-benchmark::benchmark(const methods t, const five_tuple &f, const STREAM_QUEUE &lhs, const STREAM_QUEUE &rhs) : type(t), key(f) {
+bool parse_method(const string& name, methods& m) {
+    auto lower = [](string s) {
+        transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return tolower(c); });
+        return s;
+    };
+    for(uint8_t i = 0; i < (uint8_t)methods::REFERENCE; i++) {
+        ostringstream ss;
+        ss << (methods)i;
+        if(lower(ss.str()) == lower(name)) {
+            m = (methods)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+benchmark::benchmark(const methods t, const size_t mem, const five_tuple &f, const STREAM_QUEUE &lhs, const STREAM_QUEUE &rhs) : type(t), memory(mem), key(f) {
     recorded = rhs.size();
     original = lhs.size();
 
-    vector<double> l_vec(lhs.size());
-    vector<double> r_vec(rhs.size());
-
-    transform(lhs.begin(), lhs.end(), l_vec.begin(),
-              [](const auto& p) -> double { return p.second; });
-    transform(rhs.begin(), rhs.end(), r_vec.begin(),
-              [](const auto& p) -> double { return p.second; });
+    vector<double> l_vec(lhs.data().begin(), lhs.data().end());
+    vector<double> r_vec(rhs.data().begin(), rhs.data().end());
 
     l1_norm = L1Norm(l_vec, r_vec);
     l2_norm = L2Norm(l_vec, r_vec);
@@ -157,7 +168,7 @@ benchmark::benchmark(const methods t, const five_tuple &f, const STREAM_QUEUE &l
 }
 
 ostream &operator<<(ostream &os, const benchmark &t) {
-    os << t.type << "," << benchmark::sketch_size << "," << t.key.dst_ip << "," << t.original
+    os << t.type << "," << t.memory << "," << t.key.dst_ip << "," << t.original
        << "," << t.l1_norm
        << "," << t.l2_norm
        << "," << t.avg_err
@@ -171,22 +182,39 @@ ostream &operator<<(ostream &os, const benchmark &t) {
     return os;
 }
 
-void compare(const STREAM& lhs, const STREAM& rhs, ostream& os, const methods type) {
+void summary::add(const benchmark& b) {
+    double values[] = {b.l1_norm, b.l2_norm, b.avg_err, b.energy, b.cos_dis,
+                       b.gd_l1_norm, b.gd_l2_norm, b.gd_energy, b.gd_cos_dis};
+    for(size_t i = 0; i < size(values); i++)
+        total[i] += values[i];
+    flows++;
+}
+
+ostream& operator<<(ostream& os, const summary& t) {
+    double mpps = t.transform_time > 0 ? t.packets / t.transform_time / 1e6 : 0.;
+    os << t.type << "," << t.memory << "," << t.width << "," << t.rate << "," << t.packets << "," << t.flows
+       << "," << t.transform_time << "," << mpps << "," << t.rebuild_time;
+    for(auto v : t.total)
+        os << "," << (t.flows > 0 ? v / t.flows : 0.);
+    return os;
+}
+
+void compare(const STREAM& lhs, const STREAM& rhs, ostream& os, const methods type, const size_t memory,
+             const uint32_t width, summary* total) {
     const static STREAM_QUEUE default_queue;
     for(auto &o: lhs) {
-#ifdef SELECT_OUT
-        if(o.first.hash() % HALF_WIDTH != breakpoint.hash() % HALF_WIDTH)
+        if(settings.select_out && !settings.near_breakpoint(o.first, width))
             continue;
-#endif
-#ifdef FILTER_LOW
-        if(o.second.size() < FILTER_LOW)
+        if(o.second.size() < settings.filter_low)
             continue;
-#endif
 
         auto &l_queue = o.second;
-        auto &r_queue = rhs.contains(o.first) ? rhs.find(o.first)->second : default_queue;
+        auto r_it = rhs.find(o.first);
+        auto &r_queue = r_it != rhs.end() ? r_it->second : default_queue;
 
-        benchmark p(type, o.first, l_queue, r_queue);
+        benchmark p(type, memory, o.first, l_queue, r_queue);
         os << p << endl;
+        if(total != nullptr)
+            total->add(p);
     }
 }
@@ -19,9 +19,12 @@ enum class methods : uint8_t {
     REFERENCE
 };
 ostream& operator<<(ostream& os, const methods& t);
+// match a method by its printed name, case-insensitive
+bool parse_method(const string& name, methods& m);
 
 class benchmark {
     methods type;
+    size_t memory;
     five_tuple key;
     uint32_t recorded;
     uint32_t original;
@@ -37,13 +40,37 @@ class benchmark {
     double gd_cos_dis;
 
 public:
-    constexpr static const uint32_t sketch_size = MEMORY;
     constexpr static const char format[] = "class,memory,id,length,l1,l2,are,energy,cos,g-l1,g-l2,g-energy,g-cos";
-    benchmark(methods t, const five_tuple& f, const STREAM_QUEUE& lhs, const STREAM_QUEUE& rhs);
+    benchmark(methods t, size_t mem, const five_tuple& f, const STREAM_QUEUE& lhs, const STREAM_QUEUE& rhs);
     friend ostream& operator<<(ostream& os, const benchmark& t);
+    friend struct summary;
 };
 
-void compare(const STREAM& lhs, const STREAM& rhs, ostream& os, const methods type);
+// one row per scheme and memory budget: throughput and the benchmark metrics averaged over reported flows
+struct summary {
+    methods type;
+    size_t memory;
+    // dimensions behind memory, which alone does not tell width from sample rate
+    uint32_t width;
+    uint32_t rate;
+    size_t flows = 0;
+    // l1, l2, are, energy, cos, g-l1, g-l2, g-energy, g-cos
+    double total[9]{};
+
+    size_t packets = 0;
+    double transform_time = 0.;
+    double rebuild_time = 0.;
+
+    constexpr static const char format[] =
+            "class,memory,width,rate,packets,flows,transform-time,mpps,rebuild-time,l1,l2,are,energy,cos,g-l1,g-l2,g-energy,g-cos";
+    summary(methods t, size_t mem, uint32_t w, uint32_t r) : type(t), memory(mem), width(w), rate(r) {}
+    void add(const benchmark& b);
+    friend ostream& operator<<(ostream& os, const summary& t);
+};
+
+// benchmark every flow of lhs against rhs of a sketch of the given width, accumulating into total if given
+void compare(const STREAM& lhs, const STREAM& rhs, ostream& os, const methods type, const size_t memory,
+             const uint32_t width, summary* total = nullptr);
 
 
 #endif //BENCHMARK_H
@@ -0,0 +1,221 @@
+#include <filesystem>
+
+#include "config.h"
+#include "registry.h"
+
+static string trim(const string& s) {
+    auto first = s.find_first_not_of(" \t\r\n");
+    if(first == string::npos)
+        return {};
+    auto last = s.find_last_not_of(" \t\r\n");
+    return s.substr(first, last - first + 1);
+}
+
+template<typename T>
+static bool parse_number(const string& s, T& value) {
+    auto [ptr, ec] = from_chars(s.data(), s.data() + s.size(), value);
+    return ec == errc() && ptr == s.data() + s.size();
+}
+
+static bool parse_bool(const string& s, bool& value) {
+    if(s.empty() || s == "1" || s == "true" || s == "yes" || s == "on")
+        value = true;
+    else if(s == "0" || s == "false" || s == "no" || s == "off")
+        value = false;
+    else
+        return false;
+    return true;
+}
+
+static bool is_flag(const string& key) {
+    return key == "by-bytes" || key == "stream" || key == "select-in" || key == "select-out" ||
+           key == "sweep" || key == "evaluate";
+}
+
+bool set_option(options& o, const string& key, const string& value) {
+    if(key == "input")
+        o.file_in = value;
+    else if(key == "report")
+        o.file_out = value;
+    else if(key == "flow")
+        o.flow_out = value;
+    else if(key == "meta")
+        o.meta_out = value;
+    else if(key == "summary")
+        o.summary_out = value;
+    else if(key == "config")
+        return load_config(o, value);
+    else if(key == "schemes") {
+        o.schemes.clear();
+        stringstream ss(value);
+        string name;
+        while(getline(ss, name, ',')) {
+            name = trim(name);
+            methods m;
+            if(!parse_method(name, m)) {
+                cerr << "unknown scheme: " << name << endl;
+                return false;
+            }
+            o.schemes.push_back(name);
+        }
+    }
+    else if(key == "width")
+        return parse_number(value, o.width);
+    else if(key == "rate")
+        return parse_number(value, o.rate);
+    else if(key == "length")
+        return parse_number(value, o.length);
+    else if(key == "filter-time")
+        return parse_number(value, o.filter_time);
+    else if(key == "filter-low")
+        return parse_number(value, o.filter_low);
+    else if(key == "jobs")
+        return parse_number(value, o.jobs);
+    else if(key == "ingest-jobs")
+        return parse_number(value, o.ingest_jobs);
+    else if(key == "rebuild-jobs")
+        return parse_number(value, o.rebuild_jobs);
+    else if(key == "reorder-window")
+        return parse_number(value, o.reorder_window);
+    else if(key == "flow-level") {
+        if(!parse_number(value, o.flow_level))
+            return false;
+        return o.flow_level < 32;
+    }
+    else if(key == "breakpoint") {
+        uint32_t id;
+        if(!parse_number(value, id))
+            return false;
+        o.breakpoint = five_tuple(id);
+    }
+    else if(key == "by-bytes")
+        return parse_bool(value, o.by_bytes);
+    else if(key == "stream")
+        return parse_bool(value, o.stream_in);
+    else if(key == "select-in")
+        return parse_bool(value, o.select_in);
+    else if(key == "select-out")
+        return parse_bool(value, o.select_out);
+    else if(key == "sweep")
+        return parse_bool(value, o.sweep);
+    else if(key == "evaluate") {
+        bool evaluate;
+        if(!parse_bool(value, evaluate))
+            return false;
+        o.evaluate = evaluate;
+    }
+    else
+        return false;
+    return true;
+}
+
+bool load_config(options& o, const string& fname) {
+    // the configs being read, outermost first: one naming any of them again would recurse without end
+    static vector<filesystem::path> reading;
+
+    ifstream f(fname);
+    if(!f.is_open()) {
+        cerr << "cannot open config: " << fname << endl;
+        return false;
+    }
+    error_code ec;
+    auto path = filesystem::weakly_canonical(fname, ec);
+    if(ec)
+        path = fname;
+    if(find(reading.begin(), reading.end(), path) != reading.end()) {
+        cerr << "config includes itself: " << fname << endl;
+        return false;
+    }
+    reading.push_back(path);
+    struct pop_guard {
+        ~pop_guard() { reading.pop_back(); }
+    } guard;
+
+    string line;
+    for(int n = 1; getline(f, line); n++) {
+        line = trim(line.substr(0, line.find('#')));
+        if(line.empty())
+            continue;
+        auto eq = line.find('=');
+        string key = trim(line.substr(0, eq));
+        string value = eq == string::npos ? "" : trim(line.substr(eq + 1));
+        if(!set_option(o, key, value)) {
+            cerr << fname << ":" << n << ": invalid option " << key << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool parse_options(options& o, int argc, char* argv[]) {
+    for(int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if(arg == "--help" || arg == "-h") {
+            print_usage(cout, argv[0]);
+            exit(0);
+        }
+        if(arg == "--list") {
+            for(auto& e : scheme_registry())
+                cout << e.method << ",width=" << e.width << ",rate=" << e.rate
+                     << ",length=" << e.length << ",memory=" << e.memory << endl;
+            exit(0);
+        }
+        if(!arg.starts_with("--")) {
+            o.file_in = arg;
+            continue;
+        }
+
+        string key = arg.substr(2);
+        string value;
+        auto eq = key.find('=');
+        if(eq != string::npos) {
+            value = key.substr(eq + 1);
+            key = key.substr(0, eq);
+        } else if(!is_flag(key)) {
+            if(i + 1 >= argc) {
+                cerr << "missing value for --" << key << endl;
+                return false;
+            }
+            value = argv[++i];
+        }
+
+        if(!set_option(o, key, value)) {
+            cerr << "invalid option --" << key << endl;
+            print_usage(cerr, argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+void print_usage(ostream& os, const char* program) {
+    os << "usage: " << program << " [options] [input]\n"
+       << "  --config FILE          read \"key = value\" lines from FILE\n"
+       << "  --input FILE           csv or converted trace (default data_source/hadoop15.csv)\n"
+       << "  --report FILE          per-flow metrics, empty for stdout (default report.csv)\n"
+       << "  --flow FILE            breakpoint flow samples, empty to disable (default sample.csv)\n"
+       << "  --meta FILE            timing and size per scheme, empty for stderr\n"
+       << "  --summary FILE         throughput and mean metrics per scheme and memory, empty to disable\n"
+       << "                         (default empty)\n"
+       << "  --schemes A,B,...      schemes to run, by report name (--list shows them)\n"
+       << "  --width N --rate N --length N\n"
+       << "                         sketch dimensions, must be compiled in (default 32, 32, 131072)\n"
+       << "  --sweep[=BOOL]         run every compiled-in width and rate of --length (memory budgets)\n"
+       << "  --jobs N               run at most N schemes at once, 0 for all (default 0)\n"
+       << "  --ingest-jobs N        count each scheme's packets on N threads by table rows, 0 for one per core\n"
+       << "                         (default 1)\n"
+       << "  --rebuild-jobs N       rebuild each scheme's flows on N threads, 0 to share the cores among the\n"
+       << "                         schemes running at once (default 0)\n"
+       << "  --by-bytes[=BOOL]      count bytes instead of packets\n"
+       << "  --filter-time NS       stop at the first packet at or after NS, 0 to read all\n"
+       << "  --filter-low N         only report flows with at least N samples\n"
+       << "  --select-in[=BOOL]     only read flows sharing a bucket with the breakpoint\n"
+       << "  --select-out[=BOOL]    only report flows sharing a bucket with the breakpoint\n"
+       << "  --evaluate[=BOOL]      score reported flows against the input (default true, false with --stream);\n"
+       << "                         with --stream, keeps every sample of the reported flows in memory\n"
+       << "  --breakpoint ID        flow sampled into --flow (default 2882)\n"
+       << "  --flow-level L         sample the breakpoint flow in sums over windows of 2^L ticks (default 0)\n"
+       << "  --stream[=BOOL]        feed schemes while reading instead of loading the input\n"
+       << "  --reorder-window N     packets held back to absorb late timestamps when streaming\n"
+       << "  --list                 print compiled-in scheme instantiations\n";
+}
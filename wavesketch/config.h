@@ -0,0 +1,21 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include "Utility/headers.h"
+
+using namespace std;
+
+/* command-line and config-file front end for options (Utility/debug.h)
+ *   niffler [--key=value | --key value | --flag]... [input]
+ *   a config file holds one "key = value" per line, '#' starts a comment;
+ *   options are applied in order, so later ones override earlier ones */
+
+// apply one option; return false if the key or value is invalid
+bool set_option(options& o, const string& key, const string& value);
+// apply every "key = value" line of fname; a config may name others, but not one it is read from
+bool load_config(options& o, const string& fname);
+// apply argv; return false on an invalid option, exit after --help or --list
+bool parse_options(options& o, int argc, char* argv[]);
+void print_usage(ostream& os, const char* program);
+
+#endif //CONFIG_H
@@ -0,0 +1,19 @@
+#include <iostream>
+#include "trace.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    if(argc != 3) {
+        cerr << "usage: " << argv[0] << " <input.csv> <output.trace>" << endl;
+        return -1;
+    }
+
+    auto start_time = chrono::high_resolution_clock::now();
+    size_t rows = convert_csv(argv[1], argv[2]);
+    auto end_time = chrono::high_resolution_clock::now();
+    chrono::duration<double> time_diff = end_time - start_time;
+    cerr << "converted " << rows << " rows in " << time_diff.count() << "s" << endl;
+
+    return 0;
+}
@@ -5,81 +5,260 @@
 #include "io_helper.h"
 #include "benchmark.h"
 
-STREAM parse_csv_full(const string& fname) {
-    constexpr static const int scale = 65536;
-    ifstream f(fname);
-    if(!f.is_open()) [[unlikely]]
-                exit(-1);
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-    STREAM result;
-    string line;
-    static regex line_fmt(R"(^\((TCP|UDP)\)([0-9.]+):(\d+)<>([0-9.]+):(\d+),\d*?(\d{1,9}),(\d+),\d+\s*$)");
-
-    int i = 0;
-    /*auto file_size = count_if(istreambuf_iterator<char>{f}, {},
-                              [](char c) { return c == '\n'; }) + 1;
-    cout << "total lines: " << file_size << endl;
-    cout << string(file_size / scale, '-') << endl;*/
-    while(getline(f, line)) {
-        smatch match;
-        if(regex_match(line, match, line_fmt)) {
-            five_tuple t(match[2].str(),
-                         match[4].str(),
-                         match[3].str(),
-                         match[5].str(),
-                         match[1].str());
-#ifdef SELECT_IN
-            if(t.hash() % HALF_WIDTH == breakpoint.hash() % HALF_WIDTH)
-#endif
-            result[t].emplace_back(stoul(match[6].str()), stoi(match[7].str()));
-        }
-        i++;
-        if(i % scale == 0)
-            cout << '+' << flush;
+mapped_file::mapped_file(const string& fname) {
+    fd = open(fname.c_str(), O_RDONLY);
+    if(fd < 0) [[unlikely]]
+        exit(-1);
+
+    struct stat st{};
+    if(fstat(fd, &st) != 0) [[unlikely]]
+        exit(-1);
+    length = st.st_size;
+    if(length == 0)
+        return;
+
+    void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(p == MAP_FAILED) [[unlikely]]
+        exit(-1);
+    madvise(p, length, MADV_SEQUENTIAL);
+    data = static_cast<const char*>(p);
+}
+void mapped_file::release(const char* first, const char* last) const {
+    const size_t page = sysconf(_SC_PAGESIZE);
+    size_t lo = (first - data + page - 1) / page * page;
+    size_t hi = (last - data) / page * page;
+    if(lo < hi)
+        madvise(const_cast<char*>(data) + lo, hi - lo, MADV_DONTNEED);
+}
+mapped_file::~mapped_file() {
+    if(data != nullptr)
+        munmap(const_cast<char*>(data), length);
+    if(fd >= 0)
+        close(fd);
+}
+
+// read one unsigned field followed by an optional single-character separator, skipping blanks
+static const char* scan_field(const char* p, const char* last, uint32_t& value) {
+    while(p < last && isspace(static_cast<unsigned char>(*p)))
+        p++;
+    auto [ptr, ec] = from_chars(p, last, value);
+    if(ec != errc()) [[unlikely]]
+        return nullptr;
+    p = ptr;
+    while(p < last && isspace(static_cast<unsigned char>(*p)))
+        p++;
+    return p < last ? p + 1 : p;
+}
+
+bool parse_simple_line(const char* p, const char* last, uint32_t& id, uint32_t& len, uint32_t& time) {
+    uint32_t qlen;
+    return (p = scan_field(p, last, id)) && (p = scan_field(p, last, len)) &&
+           (p = scan_field(p, last, time)) && scan_field(p, last, qlen);
+}
+
+row_status parse_simple_row(const char* p, const char* last, SORTED::value_type& row) {
+    uint32_t id, len, time;
+    if(!parse_simple_line(p, last, id, len, time))
+        return row_status::SKIP;
+
+    five_tuple ft(id);
+    // the first row at or past the filter ends the input whether or not it is selected
+    const bool stop = settings.filter_time != 0 && time >= settings.filter_time;
+    if(settings.select_in && !settings.near_breakpoint(ft, settings.width))
+        return stop ? row_status::STOP : row_status::SKIP;
+    row = {ft, time / TIMESCALE + 1, settings.by_bytes ? (DATA)len : 1};
+    return stop ? row_status::LAST : row_status::KEEP;
+}
+
+// read an ip as five_tuple::string_to_ip does: a.b.c.d, or a bare integer
+static const char* scan_ip(const char* p, const char* last, uint32_t& ip) {
+    uint32_t part;
+    auto [ptr, ec] = from_chars(p, last, part);
+    if(ec != errc()) [[unlikely]]
+        return nullptr;
+    ip = part;
+    if(ptr == last || *ptr != '.')
+        return ptr;
+
+    ip = part << 24;
+    for(int shift = 16; shift >= 0; shift -= 8) {
+        if(ptr == last || *ptr != '.') [[unlikely]]
+            return nullptr;
+        auto [next, e] = from_chars(ptr + 1, last, part);
+        if(e != errc()) [[unlikely]]
+            return nullptr;
+        ip |= part << shift;
+        ptr = next;
     }
-    cout << endl;
+    return ptr;
+}
 
-    return result;
+// read an unsigned number ending in sep, return the position after sep
+template<typename T>
+static const char* scan_until(const char* p, const char* last, char sep, T& value) {
+    uint32_t v;
+    auto [ptr, ec] = from_chars(p, last, v);
+    if(ec != errc() || ptr == last || *ptr != sep) [[unlikely]]
+        return nullptr;
+    value = v;
+    return ptr + 1;
 }
-SORTED parse_csv_simple(const string& fname) {
-    constexpr static const int scale = 65536 * 4;
-    ifstream f(fname);
-    if(!f.is_open()) [[unlikely]]
-                exit(-1);
 
-    SORTED result;
+bool parse_full_line(const char* p, const char* last, five_tuple& ft, uint32_t& len, uint64_t& second,
+                     uint32_t& time) {
+    if(last - p < 5 || p[0] != '(' || p[4] != ')')
+        return false;
+    if(memcmp(p + 1, "TCP", 3) == 0)
+        ft.protocol = 6;
+    else if(memcmp(p + 1, "UDP", 3) == 0)
+        ft.protocol = 17;
+    else
+        return false;
+    p += 5;
 
-    uint32_t i = 0;
-    uint32_t id, len, qlen;
-    uint32_t time;
-    char comma;
+    if(!(p = scan_ip(p, last, ft.src_ip)) || p == last || *p != ':' ||
+       !(p = scan_until(p + 1, last, '<', ft.src_port)) || p == last || *p != '>' ||
+       !(p = scan_ip(p + 1, last, ft.dst_ip)) || p == last || *p != ':' ||
+       !(p = scan_until(p + 1, last, ',', ft.dst_port)))
+        return false;
 
-    // ignore first line
-    f.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-    while(f >> id >> comma >> len >> comma >> time >> comma >> qlen) {
-        five_tuple ft(id);
-#ifdef SELECT_IN
-        if(ft.hash() % HALF_WIDTH == breakpoint.hash() % HALF_WIDTH)
-#endif
-#ifdef BY_BYTES
-        result.emplace_back(ft, time / TIMESCALE + 1, len);
-#else
-        result.emplace_back(ft, time / TIMESCALE + 1, 1);
-#endif
-        i++;
-        if(i % scale == 0)
-            cout << '+' << flush;
-#ifdef FILTER_TIME
-        if(time >= FILTER_TIME) [[unlikely]]
-            break;
-#endif
+    // the last 9 digits of the timestamp are the ns, the ones before them the second
+    const char* digits = p;
+    while(p < last && isdigit(static_cast<unsigned char>(*p)))
+        p++;
+    if(p == digits || p == last || *p != ',')
+        return false;
+    const char* ns = max(digits, p - 9);
+    second = 0;
+    if(ns != digits && from_chars(digits, ns, second).ec != errc())
+        return false;
+    from_chars(ns, p, time);
+
+    uint32_t qlen;
+    if(!(p = scan_until(p + 1, last, ',', len)))
+        return false;
+    auto [ptr, ec] = from_chars(p, last, qlen);
+    if(ec != errc())
+        return false;
+    return all_of(ptr, last, [](char c) { return isspace(static_cast<unsigned char>(c)); });
+}
+
+// ns of a row since the start of the capture's first second; false if the row is from an earlier second, or so
+// late that its tick does not fit in TIME
+static bool capture_time(uint64_t second, uint32_t ns, uint64_t capture_second, uint64_t& time) {
+    // the latest second whose ticks fit, checked first so the ns cannot overflow
+    constexpr static const uint64_t last_second = uint64_t(numeric_limits<TIME>::max()) * TIMESCALE / 1000000000ull;
+    if(second < capture_second || second - capture_second > last_second) [[unlikely]]
+        return false;
+    time = (second - capture_second) * 1000000000ull + ns;
+    return time / TIMESCALE < numeric_limits<TIME>::max();
+}
+static void report_bad_rows(size_t bad) {
+    if(bad > 0) [[unlikely]]
+        cerr << "skipped rows outside the capture's time range: " << bad << endl;
+}
+
+bool first_full_second(const char* first, const char* last, uint64_t& second) {
+    while(first < last) {
+        const char* eol = find(first, last, '\n');
+        five_tuple ft;
+        uint32_t len, time;
+        if(parse_full_line(first, eol, ft, len, second, time))
+            return true;
+        first = eol + (eol != last);
     }
+    return false;
+}
+
+row_status parse_full_row(const char* p, const char* last, uint64_t capture_second, SORTED::value_type& row) {
+    five_tuple ft;
+    uint64_t second, time;
+    uint32_t len, ns;
+    if(!parse_full_line(p, last, ft, len, second, ns))
+        return row_status::SKIP;
+    if(!capture_time(second, ns, capture_second, time)) [[unlikely]]
+        return row_status::BAD;
+
+    // the first row at or past the filter ends the input whether or not it is selected
+    const bool stop = settings.filter_time != 0 && time >= settings.filter_time;
+    if(settings.select_in && !settings.near_breakpoint(ft, settings.width))
+        return stop ? row_status::STOP : row_status::SKIP;
+    row = {ft, TIME(time / TIMESCALE + 1), settings.by_bytes ? (DATA)len : 1};
+    return stop ? row_status::LAST : row_status::KEEP;
+}
+
+bool is_full_file(const string& fname) {
+    ifstream f(fname);
+    string line;
+    // the first line may be a header
+    for(int i = 0; i < 2 && getline(f, line); i++)
+        if(line.starts_with("(TCP)") || line.starts_with("(UDP)"))
+            return true;
+    return false;
+}
+
+STREAM parse_csv_full(const string& fname) {
+    typedef tuple<five_tuple, uint32_t, uint32_t> full_row;
+    mapped_file f(fname);
+    uint64_t capture_second = 0;
+    first_full_second(f.begin(), f.end(), capture_second);
+
+    atomic<size_t> bad = 0;
+    auto chunks = parse_chunks<full_row>(f.begin(), f.end(),
+            [&](const char* p, const char* last, vector<full_row>& out) {
+        five_tuple ft;
+        uint64_t second, time;
+        uint32_t len, ns;
+        if(!parse_full_line(p, last, ft, len, second, ns))
+            return true;
+        // raw times are kept as ns, so they have to fit in TIME themselves
+        if(!capture_time(second, ns, capture_second, time) || time > numeric_limits<TIME>::max()) [[unlikely]] {
+            bad.fetch_add(1, memory_order_relaxed);
+            return true;
+        }
+        if(!settings.select_in || settings.near_breakpoint(ft, settings.width))
+            out.emplace_back(ft, TIME(time), len);
+        return true;
+    });
+    report_bad_rows(bad);
 
-    cout << endl;
-    f.close();
+    STREAM result;
+    for(auto& c : chunks)
+        for(auto& [ft, time, len] : c)
+            result[ft].push_back(time, len);
+    return result;
+}
 
-    sort(result.begin(), result.end(),
-         [](const auto& lhs, const auto& rhs) { return get<1>(lhs) < get<1>(rhs); });
+// chunk-parse the rows in [first, last) and sort them by time
+template<typename F>
+static SORTED parse_csv_sorted(const char* first, const char* last, F&& parse_row) {
+    atomic<size_t> bad = 0;
+    auto chunks = parse_chunks<SORTED::value_type>(first, last,
+            [&](const char* p, const char* eol, vector<SORTED::value_type>& out) {
+        SORTED::value_type row;
+        row_status status = parse_row(p, eol, row);
+        if(status == row_status::KEEP || status == row_status::LAST)
+            out.push_back(row);
+        else if(status == row_status::BAD) [[unlikely]]
+            bad.fetch_add(1, memory_order_relaxed);
+        return status == row_status::KEEP || status == row_status::SKIP || status == row_status::BAD;
+    });
+    report_bad_rows(bad);
+
+    SORTED result;
+    for(auto& c : chunks)
+        result.append(c);
+    chunks.clear();
+
+    result.sort_by_time();
+    result.hash_flows();
+    if(result.empty()) [[unlikely]]
+        return result;
 
     TIME min_time = get<1>(result.front());
     TIME max_time = get<1>(result.back());
@@ -88,38 +267,145 @@ SORTED parse_csv_simple(const string& fname) {
     return result;
 }
 
-STREAM sum_by_flow(const SORTED& data) {
-    STREAM result;
-    for(auto& p : data) {
-        auto& q = result[get<0>(p)];
-        if(q.empty() || q.back().first < get<1>(p))
-            q.emplace_back(get<1>(p), get<2>(p));
-        else
-            q.back().second += get<2>(p);
+SORTED parse_csv_full_sorted(const string& fname) {
+    mapped_file f(fname);
+    uint64_t capture_second = 0;
+    first_full_second(f.begin(), f.end(), capture_second);
+    return parse_csv_sorted(f.begin(), f.end(), [&](const char* p, const char* last, SORTED::value_type& row) {
+        return parse_full_row(p, last, capture_second, row);
+    });
+}
+
+SORTED parse_csv_simple(const string& fname) {
+    mapped_file f(fname);
+
+    // ignore first line
+    const char* first = find(f.begin(), f.end(), '\n');
+    if(first != f.end())
+        first++;
+    return parse_csv_sorted(first, f.end(), parse_simple_row);
+}
+
+vector<double> stream_transform(const vector<abstract_scheme*>& models, const vector<vector<size_t>>& groups,
+                                const string& fname, STREAM* dict, size_t& packets) {
+    constexpr static const size_t batch_size = 1u << 16;
+    constexpr static const size_t release_step = 64u << 20;
+
+    mapped_file f(fname);
+    reorder_buffer window(settings.reorder_window);
+    vector<SORTED::value_type> batch;
+    batch.reserve(batch_size);
+    vector<five_tuple> flows;
+    flows.reserve(batch_size);
+    vector<flow_digest> digest;
+    digest.reserve(batch_size);
+    vector<packet> hashed;
+    hashed.reserve(batch_size);
+    vector<double> elapse(models.size(), 0.);
+    packets = 0;
+
+    // feed the released packets to every model, timing each model separately: a model's row workers finish the
+    // batch within its timed region, so the time is all of its counting even on the wall clock
+    auto feed = [&]() {
+        // hash each packet once for all models
+        flows.clear();
+        for(auto& t : batch)
+            flows.push_back(get<0>(t));
+        digest.resize(flows.size());
+        digest_batch(flows.data(), flows.size(), digest.data());
+        hashed.clear();
+        for(size_t j = 0; j < batch.size(); j++)
+            hashed.push_back({get<0>(batch[j]), digest[j], get<1>(batch[j]), get<2>(batch[j])});
+        parallel_tasks(groups.size(), settings.jobs, [&](size_t g) {
+            for(auto i : groups[g]) {
+                double start_time = ingest_clock();
+                ingest(*models[i], hashed);
+                models[i]->wait();
+                elapse[i] += ingest_clock() - start_time;
+            }
+        });
+        for(size_t j = 0; dict && j < batch.size(); j++) {
+            if(settings.reported(get<0>(batch[j])))
+                accumulate(*dict, batch[j], digest[j]);
+            else
+                accumulate_span(*dict, batch[j], digest[j]);
+        }
+        packets += batch.size();
+        batch.clear();
+    };
+    auto release = [&](const SORTED::value_type& t) {
+        batch.push_back(t);
+        if(batch.size() == batch_size)
+            feed();
+    };
+
+    // five-tuple lines skip a header by themselves; ignore first line of a simple csv
+    bool full = is_full_file(fname);
+    uint64_t capture_second = 0;
+    if(full)
+        first_full_second(f.begin(), f.end(), capture_second);
+    auto parse_row = [&](const char* p, const char* last, SORTED::value_type& row) {
+        return full ? parse_full_row(p, last, capture_second, row) : parse_simple_row(p, last, row);
+    };
+    const char* p = f.begin();
+    if(!full) {
+        p = find(f.begin(), f.end(), '\n');
+        if(p != f.end())
+            p++;
     }
-    return result;
+    const char* consumed = f.begin();
+    SORTED::value_type row, out;
+    size_t bad = 0;
+    while(p < f.end()) {
+        const char* eol = find(p, f.end(), '\n');
+        row_status status = parse_row(p, eol, row);
+        if((status == row_status::KEEP || status == row_status::LAST) && window.push(row, out))
+            release(out);
+        bad += status == row_status::BAD;
+        if(status == row_status::LAST || status == row_status::STOP) [[unlikely]]
+            break;
+        p = eol + 1;
+
+        // drop parsed pages so resident memory does not grow with the file
+        if(size_t(p - consumed) >= release_step) [[unlikely]] {
+            f.release(consumed, p);
+            consumed = p;
+        }
+    }
+    while(window.pop(out))
+        release(out);
+    feed();
+
+    for(size_t i = 0; i < models.size(); i++) {
+        double start_time = ingest_clock();
+        models[i]->flush();
+        elapse[i] += ingest_clock() - start_time;
+    }
+
+    report_bad_rows(bad);
+    if(window.late > 0)
+        cerr << "late packets: " << window.late << endl;
+    return elapse;
 }
 
 // align rhs to lhs: assume rhs only differs from lhs in DATA value
-void align(STREAM_QUEUE lhs, STREAM_QUEUE& rhs) {
-    transform(lhs.begin(), lhs.end(), lhs.begin(),
-              [](const auto& p){ return make_pair(p.first, 0); });
-
-    auto l_it = lhs.begin();
-    auto r_it = rhs.begin();
-    while(l_it != lhs.end() && r_it != rhs.end()) {
-        if(l_it->first < r_it->first)
-            l_it++;
-        else if(l_it->first > r_it->first)
-            r_it++;
+void align(const STREAM_QUEUE& lhs, STREAM_QUEUE& rhs) {
+    STREAM_QUEUE result = lhs.zeros();
+
+    size_t l = 0, r = 0;
+    while(l < lhs.size() && r < rhs.size()) {
+        if(lhs.time(l) < rhs.time(r))
+            l++;
+        else if(lhs.time(l) > rhs.time(r))
+            r++;
         else {
-            l_it->second = r_it->second;
-            l_it++;
-            r_it++;
+            result.value(l) = rhs.value(r);
+            l++;
+            r++;
         }
     }
 
-    rhs.swap(lhs);
+    rhs = move(result);
 }
 void align(const STREAM& lhs, STREAM& rhs) {
     for(auto& p : lhs) {
@@ -129,13 +415,23 @@ void align(const STREAM& lhs, STREAM& rhs) {
     }
 }
 
-void flow_report(const STREAM& dict, ostream& fs, const methods m) {
-#ifdef FLOW_OUT
-    if(dict.contains(breakpoint)) [[likely]] {
-        for(auto &p : dict.at(breakpoint))
-            fs << m << "," << MEMORY << "," << p.first << "," << p.second << endl;
+void flow_report(const STREAM& dict, ostream& fs, const methods m, const size_t memory) {
+    if(settings.flow_out.empty())
+        return;
+    if(dict.contains(settings.breakpoint)) [[likely]] {
+        for(auto p : dict.at(settings.breakpoint))
+            fs << m << "," << memory << "," << p.first << "," << p.second << endl;
     }
-#endif
+}
+
+STREAM breakpoint_windows(const STREAM& q, const STREAM& dict) {
+    STREAM result;
+    auto it = q.find(settings.breakpoint);
+    if(it != q.end() && dict.contains(settings.breakpoint)) {
+        auto& times = dict.at(settings.breakpoint);
+        result[settings.breakpoint] = coarsen(it->second, times.front().first, times.back().first, settings.flow_level);
+    }
+    return result;
 }
 
 // demonstrates why we must use double in polygon solver
@@ -6,53 +6,271 @@
 
 using namespace std;
 
+/* memory-mapped input file, read-only */
+class mapped_file {
+    int fd = -1;
+    const char* data = nullptr;
+    size_t length = 0;
+public:
+    explicit mapped_file(const string& fname);
+    ~mapped_file();
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    const char* begin() const { return data; }
+    const char* end() const { return data + length; }
+    size_t size() const { return length; }
+    // hint that the pages fully inside [first, last) will not be read again
+    void release(const char* first, const char* last) const;
+};
+
+// split [first, last) into newline-aligned chunks and parse each chunk on its own thread;
+// parse_line(line_begin, line_end, out) appends to out and returns false to stop the whole input,
+// rows are returned chunk by chunk in file order
+template<typename T, typename F>
+vector<vector<T>> parse_chunks(const char* first, const char* last, F parse_line) {
+    constexpr static const size_t min_chunk = 1u << 20;
+    size_t total = last - first;
+    unsigned n = max<size_t>(1, min<size_t>(worker_count(), total / min_chunk));
+
+    vector<const char*> bounds(n + 1, last);
+    bounds[0] = first;
+    for(unsigned i = 1; i < n; i++) {
+        const char* p = max(bounds[i - 1], first + total / n * i);
+        p = find(p, last, '\n');
+        bounds[i] = p == last ? last : p + 1;
+    }
+
+    vector<vector<T>> result(n);
+    vector<char> stopped(n, false);
+    parallel_for(n, [&](unsigned i) {
+        result[i].reserve((bounds[i + 1] - bounds[i]) / 16);
+        const char* p = bounds[i];
+        while(p < bounds[i + 1]) {
+            const char* eol = find(p, bounds[i + 1], '\n');
+            if(!parse_line(p, eol, result[i])) {
+                stopped[i] = true;
+                break;
+            }
+            p = eol + 1;
+        }
+    });
+
+    // drop every chunk after the first one that asked to stop
+    for(unsigned i = 0; i < n; i++)
+        if(stopped[i]) {
+            result.resize(i + 1);
+            break;
+        }
+    return result;
+}
+
 /* csv parser */
+enum class row_status : uint8_t {
+    SKIP, // malformed or filtered out
+    KEEP,
+    LAST, // keep, and stop reading the input
+    STOP, // filtered out, and stop reading the input
+    BAD   // well-formed but its time cannot be kept: skipped, and counted for the caller to report
+};
+// fid,len,time,qlen
+bool parse_simple_line(const char* p, const char* last, uint32_t& id, uint32_t& len, uint32_t& time);
+row_status parse_simple_row(const char* p, const char* last, SORTED::value_type& row);
+// (TCP|UDP)a.b.c.d:port<>a.b.c.d:port,time,len,qlen; time is the ns within the second,
+// the last 9 digits of the timestamp, and second the digits before them
+bool parse_full_line(const char* p, const char* last, five_tuple& ft, uint32_t& len, uint64_t& second,
+                     uint32_t& time);
+// the second of the first five-tuple line in [first, last); false if there is none
+bool first_full_second(const char* first, const char* last, uint64_t& second);
+// a row of a capture whose first line is in capture_second, timed in ns since the start of that second; BAD for a row
+// from an earlier second
+row_status parse_full_row(const char* p, const char* last, uint64_t capture_second, SORTED::value_type& row);
+// true if fname holds five-tuple lines rather than flow ids
+bool is_full_file(const string& fname);
+// raw time and len per flow, in file order
 STREAM parse_csv_full(const string& fname);
+SORTED parse_csv_full_sorted(const string& fname);
 SORTED parse_csv_simple(const string& fname);
-STREAM sum_by_flow(const SORTED& data);
 
-/* deque alignment */
-void align(STREAM_QUEUE lhs, STREAM_QUEUE& rhs);
+// add one time-ordered packet to its flow; d is the digest of the flow
+inline void accumulate(STREAM& dict, const SORTED::value_type& p, flow_digest d) {
+    auto& q = dict.get(get<0>(p), d);
+    if(q.empty() || q.back().first < get<1>(p))
+        q.push_back(get<1>(p), get<2>(p));
+    else
+        q.value(q.size() - 1) += get<2>(p);
+}
+// widen the span of p's flow to its time: zero samples at the first and last tick seen, all rebuild reads of dict
+inline void accumulate_span(STREAM& dict, const SORTED::value_type& p, flow_digest d) {
+    auto& q = dict.get(get<0>(p), d);
+    if(!q.empty() && q.back().first >= get<1>(p))
+        return;
+    if(q.size() == 2)
+        q.pop_back();
+    q.push_back(get<1>(p), 0);
+}
+template<typename R>
+STREAM sum_by_flow(const R& data) {
+    STREAM result;
+    if constexpr(is_same_v<R, SORTED>) {
+        for(size_t i = 0; i < data.size(); i++)
+            accumulate(result, data[i], data.digest_at(i));
+    } else {
+        for(auto&& p : data)
+            accumulate(result, p, get<0>(p).digest());
+    }
+    return result;
+}
+
+/* streaming input */
+// bounded reorder window: holds back up to capacity packets and releases them in time order,
+// ties keep arrival order; a packet older than the last released one is clamped to its time
+class reorder_buffer {
+    typedef pair<uint64_t, SORTED::value_type> entry;
+    struct later {
+        bool operator()(const entry& lhs, const entry& rhs) const {
+            if(get<1>(lhs.second) != get<1>(rhs.second))
+                return get<1>(lhs.second) > get<1>(rhs.second);
+            return lhs.first > rhs.first;
+        }
+    };
+
+    priority_queue<entry, vector<entry>, later> pending;
+    size_t capacity;
+    uint64_t sequence = 0;
+    TIME released = 0;
+public:
+    size_t late = 0;
+
+    explicit reorder_buffer(size_t c) : capacity(c) {}
+
+    // return true if a packet leaves the window, stored in out
+    bool push(SORTED::value_type p, SORTED::value_type& out) {
+        if(get<1>(p) < released) [[unlikely]] {
+            get<1>(p) = released;
+            late++;
+        }
+        pending.emplace(sequence++, p);
+        if(pending.size() <= capacity)
+            return false;
+        return pop(out);
+    }
+    // release the earliest held packet
+    bool pop(SORTED::value_type& out) {
+        if(pending.empty())
+            return false;
+        out = pending.top().second;
+        pending.pop();
+        released = get<1>(out);
+        return true;
+    }
+};
+
+// feed a csv of either format straight into every model through a reorder_buffer of settings.reorder_window packets,
+// flush the models and fill dict unless it is null; return the forward-transform time of each model.
+// dict holds every sample of the settings.reported flows only and the span of the others, so unless the flows are
+// scored it grows with the flows but not with the packets.
+// groups partition the models: groups run concurrently on up to settings.jobs workers, a group's models in order
+vector<double> stream_transform(const vector<abstract_scheme*>& models, const vector<vector<size_t>>& groups,
+                                const string& fname, STREAM* dict, size_t& packets);
+
+/* series alignment */
+void align(const STREAM_QUEUE& lhs, STREAM_QUEUE& rhs);
 void align(const STREAM& lhs, STREAM& rhs);
 
 /* flow report */
-void flow_report(const STREAM& dict, ostream& fs, const methods m);
+void flow_report(const STREAM& dict, ostream& fs, const methods m, const size_t memory);
+// the breakpoint flow of q alone, summed over windows of 2^settings.flow_level ticks within its times in dict
+STREAM breakpoint_windows(const STREAM& q, const STREAM& dict);
 
-template<DerivedScheme S>
-inline void forward_transform(S& model, const SORTED& data, ostream& ms, const methods method) {
-    auto start_time = chrono::high_resolution_clock::now();
+// packets handed to count_batch at a time
+constexpr static const size_t COUNT_BATCH = 256;
 
-    for(auto& t : data)
-        model.count(get<0>(t), get<1>(t), get<2>(t));
+// count batch into model, on settings.ingest_jobs threads if model splits by rows; wait and flush wait for it
+template<typename S>
+inline void ingest(S& model, span<const packet> batch) {
+    if constexpr(requires { model.count_rows(batch, 0u); })
+        model.count_rows(batch, settings.ingest_jobs);
+    else
+        model.count_batch(batch);
+}
+// seconds on the clock timing ingestion: cpu time of the calling thread, or wall time once ingestion leaves it
+inline double ingest_clock() {
+    if(settings.ingest_jobs == 1)
+        return chrono::duration<double>(thread_clock::now().time_since_epoch()).count();
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template<DerivedScheme S, typename R>
+inline double forward_transform(S& model, const R& data) {
+    double start_time = ingest_clock();
+
+    vector<packet> batch;
+    batch.reserve(COUNT_BATCH);
+    auto push = [&](const packet& p) {
+        batch.push_back(p);
+        if(batch.size() == COUNT_BATCH) {
+            ingest(model, batch);
+            batch.clear();
+        }
+    };
+    if constexpr(is_same_v<R, SORTED>) {
+        for(size_t i = 0; i < data.size(); i++)
+            push({data.flow[i], data.digest_at(i), data.time[i], data.data[i]});
+    } else {
+        for(auto&& t : data)
+            push({get<0>(t), get<0>(t).digest(), get<1>(t), get<2>(t)});
+    }
+    ingest(model, batch);
     model.flush();
 
-    auto end_time = chrono::high_resolution_clock::now();
-    chrono::duration<double> time_diff = end_time - start_time;
-    ms << method << "," << MEMORY << "," << time_diff.count() << "," << model.serialize();
+    return ingest_clock() - start_time;
 }
+// wall time: rebuild spreads over settings.rebuild_jobs threads, the calling thread's cpu time is only its share
 template<DerivedScheme S>
-inline STREAM inverse_transform(S& model, const STREAM& dict, ostream& ms, const methods method) {
-    auto start_time = chrono::high_resolution_clock::now();
+inline STREAM inverse_transform(S& model, const STREAM& dict, double& elapse) {
+    auto start_time = chrono::steady_clock::now();
 
     STREAM result = model.rebuild(dict);
 
-    auto end_time = chrono::high_resolution_clock::now();
+    auto end_time = chrono::steady_clock::now();
     chrono::duration<double> time_diff = end_time - start_time;
-    ms << "," << time_diff.count() << endl;
+    elapse = time_diff.count();
 
     return result;
 }
+// report a model that has already been fed and flushed, and score it against dict if settings.scoring(); total holds its packets and transform time
 template<DerivedScheme S>
-void test(S& model, const SORTED& input, const STREAM& dict, ostream& os, ostream& fs, ostream& ms, const methods method) {
-    model.reset();
-    forward_transform(model, input, ms, method);
-    auto result = inverse_transform(model, dict, ms, method);
+void evaluate(S& model, summary& total, const STREAM& dict, ostream& os, ostream& fs, ostream& ms, ostream& ss) {
+    size_t size = model.serialize();
+    auto result = inverse_transform(model, dict, total.rebuild_time);
+    ms << total.type << "," << total.memory << "," << total.transform_time << "," << size
+       << "," << total.rebuild_time << endl;
 
-    flow_report(result, fs, method);
+    if(settings.flow_level == 0)
+        flow_report(result, fs, total.type, total.memory);
+    else if(!settings.flow_out.empty() && dict.contains(settings.breakpoint)) {
+        STREAM sampled;
+        sampled[settings.breakpoint] = dict.at(settings.breakpoint);
+        if constexpr(requires { model.aggregate(sampled, 0, dict); })
+            flow_report(model.aggregate(sampled, settings.flow_level, dict), fs, total.type, total.memory);
+        else
+            flow_report(breakpoint_windows(result, dict), fs, total.type, total.memory);
+    }
 
-    align(dict, result);
-    compare(dict, result, os, method);
+    if(settings.scoring()) {
+        align(dict, result);
+        compare(dict, result, os, total.type, total.memory, total.width, &total);
+    }
+    ss << total << endl;
+    model.reset();
+}
+template<DerivedScheme S, typename R>
+void test(S& model, const R& input, const STREAM& dict, summary& total,
+          ostream& os, ostream& fs, ostream& ms, ostream& ss) {
     model.reset();
+    total.transform_time = forward_transform(model, input);
+    evaluate(model, total, dict, os, fs, ms, ss);
 }
 
 
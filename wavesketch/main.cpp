@@ -2,92 +2,210 @@
 #include "Utility/headers.h"
 #include "io_helper.h"
 #include "benchmark.h"
-
-#include "OmniWindow/omniwindow.h"
-#include "Fourier/fourier.h"
-#include "PersistCMS/persistCMS.h"
-#include "PersistAMS/persistAMS.h"
-#include "Wavelet/wavelet.h"
-#include "NaiveCMS/naiveCMS.h"
-#include "WaveletAlt/wavelet_alt.h"
+#include "trace.h"
+#include "config.h"
+#include "registry.h"
 
 using namespace std;
 
-int main() {
-    auto start_time = chrono::high_resolution_clock::now();
-    auto input = parse_csv_simple(FILE_IN);
-    auto parse_time = chrono::high_resolution_clock::now();
-    chrono::duration<double> parse_diff = parse_time - start_time;
-    cerr << "parse time: " << parse_diff.count() << "s" << endl;
+struct scheme_instance {
+    const scheme_entry* entry;
+    unique_ptr<abstract_scheme> model;
+};
+typedef vector<scheme_instance> SCHEMES;
+
+// report, flow, meta and summary lines of one scheme, written out in scheme order once every scheme is done
+struct scheme_output {
+    ostringstream os, fs, ms, ss;
+};
 
-    auto dict = sum_by_flow(input);
+// true if e has the dimensions in settings, or any width and rate of its length when sweeping
+bool in_dimensions(const scheme_entry& e) {
+    if(e.length != settings.length)
+        return false;
+    return settings.sweep || (e.width == settings.width && e.rate == settings.rate);
+}
 
-#ifdef FILE_OUT
-    ofstream os(FILE_OUT, ios_base::out | ios_base::app);
-    if(!os) [[unlikely]]
-        exit(-1);
-    if(os.tellp() == 0)
-        os << benchmark::format << endl;
-#else
-    ostream& os = cout;
-#endif
-#ifdef FLOW_OUT
-    ofstream fs(FLOW_OUT, ios_base::out);
-    if(!fs) [[unlikely]]
-        exit(-1);
-    if(fs.tellp() == 0) {
-        fs << "class,memory,time,data" << endl;
-        flow_report(dict, fs, methods::REFERENCE);
+// every scheme selected in settings, in registry order; empty with an error message if one is not compiled in
+SCHEMES enabled_schemes() {
+    vector<methods> selected;
+    for(auto& name : settings.schemes) {
+        methods m;
+        if(!parse_method(name, m)) {
+            cerr << "unknown scheme: " << name << endl;
+            return {};
+        }
+        auto& registry = scheme_registry();
+        if(none_of(registry.begin(), registry.end(),
+                   [&](const scheme_entry& e) { return e.method == m && in_dimensions(e); })) {
+            cerr << name << " is not compiled in for ";
+            if(!settings.sweep)
+                cerr << "width=" << settings.width << ", rate=" << settings.rate << ", ";
+            cerr << "length=" << settings.length << " (see --list)" << endl;
+            return {};
+        }
+        selected.push_back(m);
     }
-#else
-    ostream& fs = cout;
-#endif
-#ifdef META_OUT
-    ofstream ms(META_OUT, ios_base::out | ios_base::app);
-    if(!ms) [[unlikely]]
-        exit(-1);
-    if(ms.tellp() == 0)
-        ms << "class,memory,transform-time,size,rebuild-time" << endl;
-#else
-    ostream& ms = cerr;
-#endif
 
-#ifdef USE_NAIVE_CMS
-    static naiveCMS scheme1{};
-    test(scheme1, input, dict, os, fs, ms, USE_NAIVE_CMS);
-#endif
-#ifdef USE_OMNIWINDOW
-    static omniwindow scheme2{};
-    test(scheme2, input, dict, os, fs, ms, USE_OMNIWINDOW);
-#endif
-#ifdef USE_FOURIER
-    static fourier scheme3{};
-    test(scheme3, input, dict, os, fs, ms, USE_FOURIER);
-#endif
-#ifdef USE_PERSIST_CMS
-    static persistCMS scheme4{};
-    test(scheme4, input, dict, os, fs, ms, USE_PERSIST_CMS);
-#endif
-#ifdef USE_PERSIST_AMS
-    static persistAMS scheme5{};
-    test(scheme5, input, dict, os, fs, ms, USE_PERSIST_AMS);
-#endif
-#ifdef USE_WAVE_IDEAL
-    static wavelet<false> scheme6{};
-    test(scheme6, input, dict, os, fs, ms, USE_WAVE_IDEAL);
-#endif
-#ifdef USE_WAVE_PRACTICAL
-    static wavelet<true> scheme7{};
-    test(scheme7, input, dict, os, fs, ms, USE_WAVE_PRACTICAL);
-#endif
-#ifdef USE_WAVE_ALT_I
-    static wavelet_alt<1> scheme8{};
-    test(scheme8, input, dict, os, fs, ms, USE_WAVE_ALT_I);
-#endif
-#ifdef USE_WAVE_ALT_P
-    static wavelet_alt<2> scheme9{};
-    test(scheme9, input, dict, os, fs, ms, USE_WAVE_ALT_P);
-#endif
+    SCHEMES result;
+    for(auto& e : scheme_registry())
+        if(in_dimensions(e) && find(selected.begin(), selected.end(), e.method) != selected.end())
+            result.push_back({&e, e.create()});
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    if(!parse_options(settings, argc, argv))
+        return -1;
+    // the input is read once for every width swept, so it cannot keep the flows near the breakpoint at one of them
+    if(settings.select_in && settings.sweep) {
+        cerr << "--select-in cannot be combined with --sweep" << endl;
+        return -1;
+    }
+
+    auto schemes = enabled_schemes();
+    if(schemes.empty()) [[unlikely]]
+        return -1;
+    // the reference samples are written once per memory budget, as every scheme's samples are under --sweep
+    vector<size_t> budgets;
+    for(auto& s : schemes)
+        if(find(budgets.begin(), budgets.end(), s.entry->memory) == budgets.end())
+            budgets.push_back(s.entry->memory);
+
+    ofstream report_file, flow_file, meta_file;
+    if(!settings.file_out.empty()) {
+        report_file.open(settings.file_out, ios_base::out | ios_base::app);
+        if(!report_file) [[unlikely]]
+            exit(-1);
+        if(report_file.tellp() == 0)
+            report_file << benchmark::format << endl;
+    }
+    ostream& os = settings.file_out.empty() ? cout : report_file;
+    bool reference = false;
+    if(!settings.flow_out.empty()) {
+        flow_file.open(settings.flow_out, ios_base::out);
+        if(!flow_file) [[unlikely]]
+            exit(-1);
+        reference = flow_file.tellp() == 0;
+    }
+    ostream& fs = settings.flow_out.empty() ? cout : flow_file;
+    if(!settings.meta_out.empty()) {
+        meta_file.open(settings.meta_out, ios_base::out | ios_base::app);
+        if(!meta_file) [[unlikely]]
+            exit(-1);
+        if(meta_file.tellp() == 0)
+            meta_file << "class,memory,transform-time,size,rebuild-time" << endl;
+    }
+    ostream& ms = settings.meta_out.empty() ? cerr : meta_file;
+    ofstream summary_file;
+    if(!settings.summary_out.empty()) {
+        summary_file.open(settings.summary_out, ios_base::out | ios_base::app);
+        if(!summary_file) [[unlikely]]
+            exit(-1);
+        if(summary_file.tellp() == 0)
+            summary_file << summary::format << endl;
+    }
+
+    auto report_reference = [&](const STREAM& dict) {
+        if(reference) {
+            fs << "class,memory,time,data" << endl;
+            STREAM windows;
+            if(settings.flow_level != 0)
+                windows = breakpoint_windows(dict, dict);
+            for(auto memory : budgets)
+                flow_report(settings.flow_level == 0 ? dict : windows, fs, methods::REFERENCE, memory);
+        }
+    };
+
+    // schemes only read the input and dict, so independent ones run on their own threads
+    vector<const scheme_entry*> entries;
+    for(auto& s : schemes)
+        entries.push_back(s.entry);
+    auto groups = independent_groups(entries);
+    // share the cores among the schemes that rebuild at once, so their rebuild wall times do not contend
+    if(settings.rebuild_jobs == 0) {
+        size_t concurrent = settings.jobs == 0 ? groups.size() : min<size_t>(settings.jobs, groups.size());
+        settings.rebuild_jobs = max<size_t>(1, worker_count() / max<size_t>(1, concurrent));
+    }
+    vector<scheme_output> outputs(schemes.size());
+    auto each_scheme = [&](const vector<vector<size_t>>& parts, auto&& f) {
+        parallel_tasks(parts.size(), settings.jobs, [&](size_t g) {
+            for(auto i : parts[g])
+                f(schemes[i], outputs[i]);
+        });
+    };
+    auto write_outputs = [&]() {
+        for(auto& out : outputs) {
+            os << out.os.str() << flush;
+            fs << out.fs.str() << flush;
+            ms << out.ms.str() << flush;
+            if(summary_file.is_open())
+                summary_file << out.ss.str() << flush;
+        }
+    };
+    auto run = [&](const auto& input) {
+        auto dict = sum_by_flow(input);
+        report_reference(dict);
+        size_t packets = distance(input.begin(), input.end());
+        each_scheme(groups, [&](scheme_instance& s, scheme_output& out) {
+            summary total(s.entry->method, s.entry->memory, s.entry->width, s.entry->rate);
+            total.packets = packets;
+            test(*s.model, input, dict, total, out.os, out.fs, out.ms, out.ss);
+        });
+        write_outputs();
+    };
+
+    auto start_time = chrono::high_resolution_clock::now();
+    if(settings.stream_in) {
+        // a chain's later schemes count on the state its earlier ones leave at rebuild, as the Practical wavelets
+        // on the thresholds set by Ideal: pass k streams the k-th scheme of every group once pass k - 1 is evaluated,
+        // and only the first pass fills the ground truth
+        STREAM dict;
+        vector<double> transform_time(schemes.size());
+        for(size_t k = 0;; k++) {
+            vector<vector<size_t>> pass, parts;
+            vector<abstract_scheme*> models;
+            for(auto& g : groups)
+                if(k < g.size()) {
+                    pass.push_back({g[k]});
+                    parts.push_back({models.size()});
+                    schemes[g[k]].model->reset();
+                    models.push_back(schemes[g[k]].model.get());
+                }
+            if(models.empty())
+                break;
+
+            size_t packets;
+            auto elapse = stream_transform(models, parts, settings.file_in, k == 0 ? &dict : nullptr, packets);
+            chrono::duration<double> stream_diff = chrono::high_resolution_clock::now() - start_time;
+            cerr << "stream time: " << stream_diff.count() << "s" << endl;
+            for(size_t j = 0; j < pass.size(); j++)
+                transform_time[pass[j][0]] = elapse[j];
+
+            if(k == 0)
+                report_reference(dict);
+            each_scheme(pass, [&](scheme_instance& s, scheme_output& out) {
+                summary total(s.entry->method, s.entry->memory, s.entry->width, s.entry->rate);
+                total.packets = packets;
+                total.transform_time = transform_time[&s - schemes.data()];
+                evaluate(*s.model, total, dict, out.os, out.fs, out.ms, out.ss);
+            });
+            start_time = chrono::high_resolution_clock::now();
+        }
+        write_outputs();
+    } else if(is_trace_file(settings.file_in)) {
+        trace_view input(settings.file_in);
+        chrono::duration<double> load_diff = chrono::high_resolution_clock::now() - start_time;
+        cerr << "load time: " << load_diff.count() << "s" << endl;
+        run(input);
+    } else {
+        auto input = is_full_file(settings.file_in) ? parse_csv_full_sorted(settings.file_in)
+                                                    : parse_csv_simple(settings.file_in);
+        chrono::duration<double> parse_diff = chrono::high_resolution_clock::now() - start_time;
+        cerr << "parse time: " << parse_diff.count() << "s" << endl;
+        cerr << "parse rate: " << input.size() / parse_diff.count() << " rows/s" << endl;
+        run(input);
+    }
 
     return 0;
 }
@@ -0,0 +1,79 @@
+#include "registry.h"
+
+#include "OmniWindow/omniwindow.h"
+#include "Fourier/fourier.h"
+#include "PersistCMS/persistCMS.h"
+#include "PersistAMS/persistAMS.h"
+#include "Wavelet/wavelet.h"
+#include "NaiveCMS/naiveCMS.h"
+#include "WaveletAlt/wavelet_alt.h"
+
+// parameter sets compiled into niffler: a width sweep at the default rate, plus two sampling rates
+typedef tuple<
+        parameter<8u>,
+        parameter<16u>,
+        parameter<32u>,
+        parameter<64u>,
+        parameter<128u>,
+        parameter<32u, 16u>,
+        parameter<32u, 64u>
+> PARAMETERS;
+
+// schemes built on the static pseudo_heap<Wavelet::record<P>, ...> state
+constexpr static const uint8_t WAVELET_THRESHOLD = 1;
+
+template<typename S, typename P>
+static scheme_entry make_entry(methods m, uint8_t chain = 0) {
+    return {m, P::FULL_WIDTH, P::SAMPLE_RATE, P::MAX_LENGTH, P::MEMORY, chain,
+            []() -> unique_ptr<abstract_scheme> { return make_unique<scheme_model<S>>(); }};
+}
+
+// wavelet<false> must run before wavelet<true>: its rebuild sets the shared pseudo_heap thresholds,
+// whose random generator wavelet_alt<2> (heavy part by threshold) also draws from
+template<typename P>
+static void register_parameter(vector<scheme_entry>& result) {
+    result.push_back(make_entry<naiveCMS<P>, P>(methods::NAIVE_CMS));
+    result.push_back(make_entry<omniwindow<P>, P>(methods::OMNIWINDOW));
+    result.push_back(make_entry<fourier<P>, P>(methods::FOURIER));
+    result.push_back(make_entry<persistCMS<P>, P>(methods::PERSIST_CMS));
+    result.push_back(make_entry<persistAMS<P>, P>(methods::PERSIST_AMS));
+    result.push_back(make_entry<wavelet<false, P>, P>(methods::WAVE_IDEAL, WAVELET_THRESHOLD));
+    result.push_back(make_entry<wavelet<true, P>, P>(methods::WAVE_PRACTICAL, WAVELET_THRESHOLD));
+    result.push_back(make_entry<wavelet_alt<1, P>, P>(methods::WAVE_ALT_I));
+    result.push_back(make_entry<wavelet_alt<2, P>, P>(methods::WAVE_ALT_P, WAVELET_THRESHOLD));
+}
+
+const vector<scheme_entry>& scheme_registry() {
+    static const vector<scheme_entry> result = []() {
+        vector<scheme_entry> entries;
+        apply([&](auto... p) { (register_parameter<decltype(p)>(entries), ...); }, PARAMETERS{});
+        return entries;
+    }();
+    return result;
+}
+
+const scheme_entry* find_scheme(methods m, uint32_t width, uint32_t rate, uint32_t length) {
+    for(auto& e : scheme_registry())
+        if(e.method == m && e.width == width && e.rate == rate && e.length == length)
+            return &e;
+    return nullptr;
+}
+
+vector<vector<size_t>> independent_groups(const vector<const scheme_entry*>& entries) {
+    vector<vector<size_t>> result;
+    vector<const scheme_entry*> heads;
+    for(size_t i = 0; i < entries.size(); i++) {
+        auto& e = *entries[i];
+        auto same_chain = [&](const scheme_entry* h) {
+            return e.chain != 0 && h->chain == e.chain &&
+                   h->width == e.width && h->rate == e.rate && h->length == e.length;
+        };
+        auto it = find_if(heads.begin(), heads.end(), same_chain);
+        if(it == heads.end()) {
+            heads.push_back(&e);
+            result.push_back({i});
+        } else
+            result[it - heads.begin()].push_back(i);
+    }
+    return result;
+}
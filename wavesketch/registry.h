@@ -0,0 +1,31 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include <memory>
+
+#include "Utility/headers.h"
+#include "benchmark.h"
+
+using namespace std;
+
+/* scheme instantiations compiled into the binary, selected at runtime */
+struct scheme_entry {
+    methods method;
+    // template parameters of the instantiation
+    uint32_t width;
+    uint32_t rate;
+    uint32_t length;
+    size_t memory;
+    // non-zero if the scheme shares static state with others of the same chain and parameter set
+    uint8_t chain;
+    unique_ptr<abstract_scheme> (*create)();
+};
+
+// every compiled-in instantiation, grouped by parameter set and ordered by execution within a set
+const vector<scheme_entry>& scheme_registry();
+// entry of method m at the given dimensions, nullptr if not compiled in
+const scheme_entry* find_scheme(methods m, uint32_t width, uint32_t rate, uint32_t length);
+// partition entries into groups that may run concurrently; a chain stays in one group, in the given order
+vector<vector<size_t>> independent_groups(const vector<const scheme_entry*>& entries);
+
+#endif //REGISTRY_H
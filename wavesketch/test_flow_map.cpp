@@ -0,0 +1,74 @@
+#include <iostream>
+#include <unordered_map>
+#include "Utility/headers.h"
+
+using namespace std;
+
+/* flow map test: a flow_map and a flow_set filled through many growths must hold what an unordered_map and
+ * unordered_set filled alike hold, iterate each entry once, survive copy and move, and refill after clear */
+static bool same(const flow_map<uint32_t>& m, const unordered_map<five_tuple, uint32_t>& expected) {
+    if(m.size() != expected.size())
+        return false;
+    size_t visited = 0;
+    for(auto& [f, v] : m) {
+        auto it = expected.find(f);
+        if(it == expected.end() || it->second != v)
+            return false;
+        visited++;
+    }
+    return visited == expected.size() && all_of(expected.begin(), expected.end(), [&](auto& p) {
+        return m.contains(p.first) && m.at(p.first) == p.second;
+    });
+}
+
+int main() {
+    mt19937 gen(0xF10);
+    flow_map<uint32_t> m;
+    flow_set s;
+    unordered_map<five_tuple, uint32_t> expected;
+    // ports and protocols vary too, so keys differ beyond their first field
+    for(uint32_t i = 0; i < 200000; i++) {
+        five_tuple f(gen() % 50000, gen() % 4, gen() % 3, 80, gen() % 2 ? 6 : 17);
+        uint32_t v = gen();
+        if(s.insert(f).second == expected.contains(f)) {
+            cerr << "set insert disagrees with unordered_map on flow " << i << endl;
+            return -1;
+        }
+        if(i % 2)
+            m[f] += v;
+        else
+            m.get(f, f.digest()) += v;
+        expected[f] += v;
+    }
+    if(s.size() != expected.size() || !same(m, expected)) {
+        cerr << "filled map differs from unordered_map" << endl;
+        return -1;
+    }
+    for(auto& f : s)
+        if(!expected.contains(f)) {
+            cerr << "set holds a flow never inserted" << endl;
+            return -1;
+        }
+    if(m.contains(five_tuple(50000, 0, 0, 0, 0)) || m.find(five_tuple(50001)) != m.end()) {
+        cerr << "map finds a flow never inserted" << endl;
+        return -1;
+    }
+
+    flow_map<uint32_t> copied = m, moved = move(copied);
+    if(!same(moved, expected) || !copied.empty()) {
+        cerr << "copy or move lost entries" << endl;
+        return -1;
+    }
+    m.clear();
+    expected.clear();
+    for(uint32_t i = 0; i < 1000; i++) {
+        m[five_tuple(i)] = i;
+        expected[five_tuple(i)] = i;
+    }
+    if(!same(m, expected)) {
+        cerr << "map refilled after clear differs" << endl;
+        return -1;
+    }
+    cout << "flow map: ok" << endl;
+    return 0;
+}
@@ -0,0 +1,40 @@
+#include <iostream>
+#include "Utility/headers.h"
+
+using namespace std;
+
+/* hash kernel test: every digest kernel this cpu runs must give five_tuple::digest bit for bit, for batches of
+ * every tail length 0-7 past whole steps of 8 keys, from aligned and unaligned starts */
+int main() {
+    mt19937 gen(0x4A5B);
+    vector<five_tuple> keys(8 * 64 + 8);
+    for(auto& k : keys)
+        k = five_tuple(gen(), gen(), gen(), gen(), gen());
+
+    vector<hash_simd::kernels> kernels = {hash_simd::scalar};
+#ifdef HASH_SIMD_X86
+    if(__builtin_cpu_supports("avx2"))
+        kernels.push_back({"avx2", hash_simd::digest_avx2});
+#endif
+    for(auto& k : kernels) {
+        for(size_t offset : {0, 1, 3})
+            for(size_t steps : {0, 1, 5, 63})
+                for(size_t tail = 0; tail < 8; tail++) {
+                    size_t n = steps * 8 + tail;
+                    vector<flow_digest> out(n + 1, {0xFFFFFFFF});
+                    k.digest(keys.data() + offset, n, out.data());
+                    for(size_t i = 0; i < n; i++)
+                        if(out[i].mix != keys[offset + i].digest().mix) {
+                            cerr << k.name << ": key " << i << " of " << n << " from " << offset
+                                 << " differs from five_tuple::digest" << endl;
+                            return -1;
+                        }
+                    if(out[n].mix != 0xFFFFFFFF) {
+                        cerr << k.name << ": wrote past " << n << " keys" << endl;
+                        return -1;
+                    }
+                }
+        cout << k.name << ": ok" << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include <iostream>
+#include "Utility/headers.h"
+#include "Wavelet/record.h"
+#include "Fourier/record.h"
+
+using namespace std;
+
+/* heap test: heap::insert sifts by keys it reads once per level; it must leave the array exactly as sifting by
+ * comparing the records does, so the same records stay, in the same order, ties broken the same way. values
+ * come from a narrow range so ties are common */
+template<typename T, uint32_t SIZE>
+struct reference {
+    T heap_data[SIZE]{};
+    uint16_t size = 0;
+
+    void insert(T r) {
+        if(size < SIZE) {
+            heap_data[size++] = r;
+            push_heap(heap_data, heap_data + size, greater<>());
+            return;
+        }
+        const int last_idx = SIZE - 1;
+        if(heap_data[0] > r)
+            return;
+        int idx = 0;
+        while(idx <= HEAP_PARENT(last_idx)) {
+            int child = HEAP_LEFT(idx);
+            if(child < last_idx && heap_data[child] > heap_data[child + 1])
+                child++;
+            if(r < heap_data[child])
+                break;
+            heap_data[idx] = heap_data[child];
+            idx = child;
+        }
+        heap_data[idx] = r;
+    }
+};
+
+template<typename T, uint32_t SIZE, typename G, typename E>
+static bool same_as_reference(const char* name, G&& make, E&& equal) {
+    mt19937 gen(0x4EA9);
+    heap<T, SIZE> h;
+    reference<T, SIZE> ref;
+    for(int i = 0; i < 200000; i++) {
+        T r = make(gen);
+        h.insert(r);
+        ref.insert(r);
+        if(h.size != ref.size || !std::equal(h.begin(), h.end(), ref.heap_data, equal)) {
+            cerr << name << ": heap differs from the reference after " << i + 1 << " records" << endl;
+            return false;
+        }
+    }
+    cout << name << ": ok" << endl;
+    return true;
+}
+
+int main() {
+    typedef Wavelet::record<> record;
+    auto same_record = [](const record& l, const record& r) {
+        return l.pos == r.pos && l.sqrt == r.sqrt && l.sign == r.sign && l.normalized == r.normalized;
+    };
+    auto make_record = [](mt19937& gen) { return record(gen() % (default_parameter::INDEX_MASK + 1), gen() % 64); };
+    if(!same_as_reference<record, 40>("Wavelet record, even depth", make_record, same_record) ||
+       !same_as_reference<record, 41>("Wavelet record, odd depth", make_record, same_record))
+        return -1;
+
+    auto make_fourier = [](mt19937& gen) { return Fourier::record{uint16_t(gen()), float(int(gen() % 32) - 16)}; };
+    auto same_fourier = [](const Fourier::record& l, const Fourier::record& r) {
+        return l.pos == r.pos && l.data == r.data;
+    };
+    if(!same_as_reference<Fourier::record, 40>("Fourier record", make_fourier, same_fourier))
+        return -1;
+    return 0;
+}
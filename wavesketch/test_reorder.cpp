@@ -0,0 +1,50 @@
+#include <iostream>
+#include "Utility/headers.h"
+#include "io_helper.h"
+
+using namespace std;
+
+/* reorder window test: a buffer of capacity packets releases nothing until it holds one more, then the earliest
+ * held packet per push, ties in arrival order; a packet at the last released time is on time, one before it is
+ * clamped to that time and counted late */
+int main() {
+    constexpr static const size_t capacity = 4;
+    reorder_buffer window(capacity);
+    SORTED::value_type out;
+    vector<SORTED::value_type> released;
+
+    // times 5 4 3 2 fill the window; ids tell tied packets apart
+    TIME times[] = {5, 4, 3, 2};
+    for(uint32_t i = 0; i < capacity; i++)
+        if(window.push({five_tuple(i), times[i], 1}, out)) {
+            cerr << "released packet " << i << " before the window was full" << endl;
+            return -1;
+        }
+    // one more releases the earliest: time 2
+    if(!window.push({five_tuple(4), 4, 1}, out) || get<1>(out) != 2) {
+        cerr << "window did not release the earliest packet once full" << endl;
+        return -1;
+    }
+    released.push_back(out);
+    // at the released time: on time; before it: late, clamped to 2
+    window.push({five_tuple(5), 2, 1}, out);
+    released.push_back(out);
+    window.push({five_tuple(6), 1, 1}, out);
+    released.push_back(out);
+    while(window.pop(out))
+        released.push_back(out);
+
+    // 2(id 3) 2(id 5) 2(id 6) 3(id 2) 4(id 1) 4(id 4) 5(id 0)
+    vector<pair<TIME, uint32_t>> expected = {{2, 3}, {2, 5}, {2, 6}, {3, 2}, {4, 1}, {4, 4}, {5, 0}};
+    if(released.size() != expected.size() || window.late != 1) {
+        cerr << released.size() << " packets released, " << window.late << " late" << endl;
+        return -1;
+    }
+    for(size_t i = 0; i < expected.size(); i++)
+        if(get<1>(released[i]) != expected[i].first || !(get<0>(released[i]) == five_tuple(expected[i].second))) {
+            cerr << "packet " << i << " released out of order" << endl;
+            return -1;
+        }
+    cout << "reorder window: ok" << endl;
+    return 0;
+}
@@ -0,0 +1,37 @@
+#include <iostream>
+#include "Utility/headers.h"
+
+using namespace std;
+
+/* radix sort test: sort_by_time must put rows in the order std::stable_sort gives them, equal times in trace
+ * order, both for times over the whole 32-bit range and for times sharing their high digits, with enough rows
+ * for the sort to split into slices */
+static bool check(const char* name, uint32_t range) {
+    mt19937 gen(0x50E7 + range);
+    SORTED rows;
+    for(uint32_t i = 0; i < (1u << 19); i++)
+        rows.emplace_back(five_tuple(i), range == 0 ? gen() : gen() % range, i);
+
+    vector<uint32_t> expected(rows.size());
+    for(uint32_t i = 0; i < expected.size(); i++)
+        expected[i] = i;
+    stable_sort(expected.begin(), expected.end(), [&](uint32_t l, uint32_t r) { return rows.time[l] < rows.time[r]; });
+    vector<TIME> times(rows.size());
+    for(size_t i = 0; i < times.size(); i++)
+        times[i] = rows.time[expected[i]];
+
+    auto order = rows.sort_by_time();
+    for(size_t i = 0; i < rows.size(); i++)
+        if(order[i] != expected[i] || rows.time[i] != times[i] || rows.data[i] != DATA(expected[i])) {
+            cerr << name << ": row " << i << " differs from std::stable_sort" << endl;
+            return false;
+        }
+    cout << name << ": ok" << endl;
+    return true;
+}
+
+int main() {
+    if(!check("full range", 0) || !check("shared high digits", 1000))
+        return -1;
+    return 0;
+}
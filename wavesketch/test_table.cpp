@@ -0,0 +1,28 @@
+#include <iostream>
+#include <memory>
+#include "Utility/headers.h"
+#include "PersistAMS/persistAMS.h"
+#include "PersistCMS/persistCMS.h"
+
+using namespace std;
+
+/* table lifetime test: fill a Persist scheme past a few counter lengths, so both sealed history and live
+ * counters holding pool nodes exist, then destroy it without a reset; run under ASan to catch the pools
+ * going before the counters */
+template<typename S>
+static void fill_and_destroy(const char* name) {
+    auto s = make_unique<S>();
+    mt19937 gen(0x7AB1E);
+    for(TIME t = 1; t < 3 * default_parameter::MAX_LENGTH; t += 1 + gen() % 4) {
+        five_tuple f(gen() % 64);
+        s->count(f, f.digest(), t, 1 + gen() % 8);
+    }
+    s.reset();
+    cout << name << ": ok" << endl;
+}
+
+int main() {
+    fill_and_destroy<persistAMS<>>("Persist-AMS");
+    fill_and_destroy<persistCMS<>>("Persist-CMS");
+    return 0;
+}
@@ -0,0 +1,116 @@
+#include "trace.h"
+
+trace_view::trace_view(const string& fname) : file(fname) {
+    if(file.size() < sizeof(trace_header) ||
+       memcmp(file.begin(), trace_header::signature, sizeof(trace_header::signature)) != 0) [[unlikely]] {
+        cerr << fname << " is not a converted trace" << endl;
+        exit(-1);
+    }
+
+    header = reinterpret_cast<const trace_header*>(file.begin());
+    if(header->version != trace_header::current_version) [[unlikely]] {
+        cerr << "trace version " << header->version << ", expected " << trace_header::current_version
+             << ": re-convert the trace with niffler_convert" << endl;
+        exit(-1);
+    }
+    if(header->timescale != TIMESCALE) [[unlikely]] {
+        cerr << "trace quantized with TIMESCALE " << header->timescale << ", expected " << TIMESCALE << endl;
+        exit(-1);
+    }
+
+    size_t column = trace_column_size(header->count);
+    if(file.size() < sizeof(trace_header) + column * 4) [[unlikely]] {
+        cerr << "trace of " << header->count << " rows truncated: re-convert the trace with niffler_convert" << endl;
+        exit(-1);
+    }
+
+    const char* base = file.begin() + sizeof(trace_header);
+    flows = reinterpret_cast<const uint32_t*>(base);
+    times = reinterpret_cast<const TIME*>(base + column);
+    lengths = reinterpret_cast<const DATA*>(base + column * 2);
+    raw_times = reinterpret_cast<const uint32_t*>(base + column * 3);
+    rows = header->count;
+
+    // the csv parser stops at the first row at or past the filter, keeping it: in file order the raw times rise,
+    // so that row is found by binary search. out of order, the rows before it are not a prefix of the trace
+    if(settings.filter_time != 0) {
+        if(!(header->flags & trace_header::FILE_ORDER)) [[unlikely]] {
+            cerr << "--filter-time needs a trace converted from a csv in time order" << endl;
+            exit(-1);
+        }
+        rows = min<size_t>(rows, lower_bound(raw_times, raw_times + rows, settings.filter_time) - raw_times + 1);
+    }
+}
+
+bool is_trace_file(const string& fname) {
+    ifstream f(fname, ios_base::binary);
+    char magic[sizeof(trace_header::signature)]{};
+    f.read(magic, sizeof(magic));
+    return f && memcmp(magic, trace_header::signature, sizeof(magic)) == 0;
+}
+
+size_t convert_csv(const string& in, const string& out) {
+    mapped_file f(in);
+    // ignore first line
+    const char* first = find(f.begin(), f.end(), '\n');
+    if(first != f.end())
+        first++;
+
+    typedef tuple<uint32_t, uint32_t, uint32_t> raw_row;
+    auto chunks = parse_chunks<raw_row>(first, f.end(),
+            [](const char* p, const char* last, vector<raw_row>& out) {
+        uint32_t id, len, time;
+        if(parse_simple_line(p, last, id, len, time))
+            out.emplace_back(id, len, time);
+        return true;
+    });
+
+    // same order as parse_csv_simple; the raw times follow the rows through the sort
+    SORTED rows;
+    vector<uint32_t> raw;
+    for(auto& c : chunks)
+        for(auto [id, len, time] : c) {
+            rows.emplace_back(five_tuple(id), time / TIMESCALE + 1, len);
+            raw.push_back(time);
+        }
+    chunks.clear();
+    const bool file_order = is_sorted(raw.begin(), raw.end());
+    auto order = rows.sort_by_time();
+    vector<uint32_t> raw_times(raw.size());
+    for(size_t i = 0; i < order.size(); i++)
+        raw_times[i] = raw[order[i]];
+
+    trace_header header{};
+    memcpy(header.magic, trace_header::signature, sizeof(header.magic));
+    header.version = trace_header::current_version;
+    header.timescale = TIMESCALE;
+    header.count = rows.size();
+    header.min_time = rows.empty() ? 0 : rows.time.front();
+    header.max_time = rows.empty() ? 0 : rows.time.back();
+    header.flags = file_order ? trace_header::FILE_ORDER : 0;
+
+    size_t column = trace_column_size(header.count);
+    vector<char> buffer(column, 0);
+    auto write_column = [&](ofstream& os, const auto& values) {
+        static_assert(sizeof(values[0]) == 4);
+        memcpy(buffer.data(), values.data(), values.size() * 4);
+        os.write(buffer.data(), column);
+    };
+
+    vector<uint32_t> flows(rows.size());
+    transform(rows.flow.begin(), rows.flow.end(), flows.begin(),
+              [](const five_tuple& f) { return f.dst_ip; });
+
+    ofstream os(out, ios_base::out | ios_base::binary | ios_base::trunc);
+    if(!os) [[unlikely]]
+        exit(-1);
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    write_column(os, flows);
+    write_column(os, rows.time);
+    write_column(os, rows.data);
+    write_column(os, raw_times);
+    if(!os) [[unlikely]]
+        exit(-1);
+
+    return rows.size();
+}
@@ -0,0 +1,93 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "Utility/headers.h"
+#include "io_helper.h"
+
+using namespace std;
+
+/* packed columnar trace, host byte order, sorted by time
+ *   a 40-byte header: magic[8], version u32, timescale u32, count u64, min_time u32, max_time u32, flags u32,
+ *   reserved u32
+ *   then four columns of count u32 values each, every one padded to a multiple of 8 bytes: flow ids, quantized
+ *   times, lengths and raw times
+ *   the raw time column keeps the csv's ns timestamps, so --filter-time cuts where the csv parser would */
+struct trace_header {
+    constexpr static const char signature[8] = {'N', 'I', 'F', 'T', 'R', 'A', 'C', 'E'};
+    constexpr static const uint32_t current_version = 1;
+    // the csv rows were in raw time order, so the trace keeps them in file order
+    constexpr static const uint32_t FILE_ORDER = 1;
+
+    char magic[8];
+    uint32_t version;
+    // TIMESCALE used to quantize the time column
+    uint32_t timescale;
+    uint64_t count;
+    // first and last quantized timestamp, inclusive
+    TIME min_time;
+    TIME max_time;
+    uint32_t flags;
+    uint32_t reserved;
+};
+static_assert(sizeof(trace_header) == 40);
+
+// column offsets are padded to 8 bytes so every column is naturally aligned in the mapping
+constexpr size_t trace_column_size(uint64_t count) {
+    return (count * 4 + 7) / 8 * 8;
+}
+
+/* zero-copy reader over a mapped trace file */
+class trace_view {
+    mapped_file file;
+    const trace_header* header = nullptr;
+    const uint32_t* flows = nullptr;
+    const TIME* times = nullptr;
+    const DATA* lengths = nullptr;
+    const uint32_t* raw_times = nullptr;
+    size_t rows = 0;
+public:
+    explicit trace_view(const string& fname);
+
+    size_t size() const { return rows; }
+    bool empty() const { return rows == 0; }
+    const trace_header& meta() const { return *header; }
+
+    SORTED::value_type operator[](size_t i) const {
+        return {five_tuple(flows[i]), times[i], settings.by_bytes ? lengths[i] : 1};
+    }
+
+    class iterator {
+        const trace_view* view;
+        size_t pos;
+
+        void skip() {
+            if(settings.select_in)
+                while(pos < view->rows && !settings.near_breakpoint(five_tuple(view->flows[pos]), settings.width))
+                    pos++;
+        }
+    public:
+        using iterator_category = forward_iterator_tag;
+        using value_type = SORTED::value_type;
+        using difference_type = ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        iterator() : view(nullptr), pos(0) {}
+        iterator(const trace_view* v, size_t p) : view(v), pos(p) { skip(); }
+
+        value_type operator*() const { return (*view)[pos]; }
+        iterator& operator++() { pos++; skip(); return *this; }
+        iterator operator++(int) { iterator old = *this; ++*this; return old; }
+        friend bool operator==(const iterator& lhs, const iterator& rhs) { return lhs.pos == rhs.pos; }
+    };
+
+    iterator begin() const { return {this, 0}; }
+    iterator end() const { return {this, rows}; }
+};
+
+// true if fname starts with a trace_header signature
+bool is_trace_file(const string& fname);
+// one-shot conversion from a fid,len,time,qlen csv into a columnar trace
+size_t convert_csv(const string& in, const string& out);
+
+#endif //TRACE_H